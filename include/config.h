@@ -3,7 +3,9 @@
 
 #include "json/json.h"
 #include "objects.h"
+#include "rng.h"
 
+#include <bitset>
 #include <fstream>
 #include <tuple>
 #include <vector>
@@ -19,20 +21,38 @@ struct ConfigurationController
   int tileSize;
   int spriteSize;
   int chunkFuzz;
+  int residentRadius;
+  int prefetchMs;
+  int memoryBudgetMB;
+  std::string chunkStorePath;
+  std::string worldPath;
+  std::uint64_t worldSeed;
   objects::mobTypesMap mobTypes;
   objects::objectTypesMap objectTypes;
   objects::biomeTypesMap biomeTypes;
-  std::map<int, std::map<std::string, BiomeType*>> biomeLevelMap;
-  std::map<int, std::vector<std::string>> biomeTypeProbabilities;
+  std::vector<std::bitset<MAX_TYPE_IDS>> biomeLevelMap;
+  // Per level, biomes that can appear there weighted by their multipliers
+  std::vector<WeightedTypes> biomeTypeWeights;
   std::vector<std::string> biomeTypeKeys;
   std::vector<std::string> terrainTypesKeys;
   objects::terrainTypesMap terrainTypes;
   objects::tileTypesMap tileTypes;
+  std::map<std::string, TypeId> biomeTypeIds;
+  std::map<std::string, TypeId> terrainTypeIds;
+  std::map<std::string, TypeId> objectTypeIds;
+  std::map<std::string, TypeId> mobTypeIds;
+  std::vector<BiomeType*> biomeTypesById;
+  std::vector<TerrainType*> terrainTypesById;
+  std::vector<ObjectType*> objectTypesById;
+  std::vector<MobType*> mobTypesById;
   Json::Value configJson;
   std::map<std::string, Sprite> sprites;
   ConfigurationController () {}
   ConfigurationController (std::string, std::map<std::string, Sprite>);
   animationMap configureAnimationMap (int, std::string);
+  template <typename T>
+  std::map<std::string, TypeId> internTypeNames (std::string, std::vector<T*>&, std::vector<Json::ArrayIndex>&);
+  TypeId getTypeId (std::map<std::string, TypeId>&, std::string);
   std::tuple<
     objects::biomeTypesMap*,
     std::vector<std::string>*,
@@ -46,14 +66,27 @@ struct ConfigurationController
       &biomeTypes, &biomeTypeKeys, &terrainTypes, &mobTypes, &objectTypes, &tileTypes
     );
   }
-  BiomeType* getRandomBiomeType(int z = 0) { return &biomeTypes[biomeTypeProbabilities[z][std::rand() % biomeTypeProbabilities[z].size()]]; }
-  TerrainType* getRandomTerrainType() { return &terrainTypes[terrainTypesKeys[std::rand() % terrainTypesKeys.size()]]; }
-  TerrainType* getRandomTerrainType(std::string biomeType)
+  BiomeType* getBiomeType(TypeId id) { return biomeTypesById[id]; }
+  TerrainType* getTerrainType(TypeId id) { return terrainTypesById[id]; }
+  ObjectType* getObjectType(TypeId id) { return objectTypesById[id]; }
+  MobType* getMobType(TypeId id) { return mobTypesById[id]; }
+  // Each picks with the draw r, so the same draw always picks the same type; without one it takes the thread's next.
+  // NO_TYPE if there is nothing to pick from, such as a level without biomes or a biome without terrains.
+  TypeId getRandomBiomeTypeId(int z, int r)
   {
-    auto t = biomeTypes[biomeType].terrainTypes.at(std::rand() % biomeTypes[biomeType].terrainTypes.size());
-    return &terrainTypes[t.first];
+    return z >= 0 && z < static_cast<int>(biomeTypeWeights.size()) ? biomeTypeWeights[z].pick(r) : NO_TYPE;
+  }
+  TypeId getRandomBiomeTypeId(int z = 0) { return getRandomBiomeTypeId(z, rng::next()); }
+  TypeId getRandomTerrainTypeId() { return terrainTypesById.size() ? rng::next() % terrainTypesById.size() : NO_TYPE; }
+  TypeId getRandomTerrainTypeId(TypeId biome, int r)
+  {
+    return biome < biomeTypesById.size() ? biomeTypesById[biome]->getRandomTerrainTypeId(r) : NO_TYPE;
+  }
+  TypeId getRandomTerrainTypeId(TypeId biome) { return getRandomTerrainTypeId(biome, rng::next()); }
+  bool biomeExistsOnLevel(TypeId id, int z)
+  {
+    return id != NO_TYPE && z >= 0 && z < static_cast<int>(biomeLevelMap.size()) && biomeLevelMap[z][id];
   }
-  bool biomeExistsOnLevel(std::string name, int z) { return biomeLevelMap[z].find(name) != biomeLevelMap[z].end(); }
 };
 
 }
@@ -10,7 +10,9 @@
 #include "input.h"
 #include "map.h"
 
+#include <chrono>
 #include <cmath>
+#include <future>
 #include <map>
 #include <string>
 #include <tuple>
@@ -76,24 +78,24 @@ struct GameEngine
   std::vector<std::string>* biomeTypeKeys;
   objects::terrainTypesMap* terrainTypes;
   objects::tileTypesMap* tileTypes;
-  objects::biomeMap* biomeMap;
-  objects::terrainMap* terrainMap;
-  objects::worldMap* worldMap;
-  objects::mobMap* mobMap;
   std::map<int, std::vector<std::shared_ptr<MobObject>>> mobs;
   std::map<std::string, Sprite>* sprites;
   SDL_Rect camera;
+  // For reporting how long startup takes to reach the first frame and the finished initial world
+  Uint32 startTicks;
+  bool firstFrame;
+  std::shared_future<void> initialWorld;
   int init();
-  std::map<int, std::map<std::string, int>> getTilesInRange (SDL_Rect*);
-  std::map<int, std::map<std::string, int>> getBiomesInRange (SDL_Rect*);
-  std::map<int, std::map<std::string, std::map<std::string, int>>> getCountsInRange (SDL_Rect*);
+  std::map<int, std::map<TypeId, int>> getTilesInRange (SDL_Rect*);
+  std::map<int, std::map<TypeId, int>> getBiomesInRange (SDL_Rect*);
+  std::map<int, std::map<std::string, std::map<TypeId, int>>> getCountsInRange (SDL_Rect*);
   int generateMapChunk(SDL_Rect*);
   int run();
   bool stopRunning() { running = false; return !running; }
   int getSpriteSize() { return spriteSize; }
   int getTileSize() { return tileSize; }
   template <typename T> T* controller() { return &engine::controller<T>; }
-  GameEngine() : running(true), movementSpeed(8), tileSize(32), spriteSize(32), zLevel(0), zMaxLevel(2) {}
+  GameEngine() : running(true), movementSpeed(8), tileSize(32), spriteSize(32), zLevel(0), zMaxLevel(2), startTicks(0), firstFrame(true) {}
 };
 
 #endif
\ No newline at end of file
@@ -6,12 +6,18 @@
 struct controller::CameraController
 {
   GameEngine* e;
-  CameraController () {}
-  CameraController (GameEngine* e)
+  // Smoothed camera velocity in tiles per second, as of the last step at lastStep ticks
+  float velocityX;
+  float velocityY;
+  Uint32 lastStep;
+  CameraController () : velocityX(0), velocityY(0), lastStep(0) {}
+  CameraController (GameEngine* e) : velocityX(0), velocityY(0), lastStep(0)
   {
     this->e = e;
   }
   void scrollCamera(int);
+  void trackStep(int, int);
+  Rect predictView(int);
   void iterateOverTilesInView (std::function<void(std::tuple<int, int, int, int>)>);
 };
 
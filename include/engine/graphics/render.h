@@ -15,9 +15,10 @@ struct engine::graphics::RenderController
   int renderCopySprite(Sprite*, std::tuple<int, int, int, int>);
   int renderCopySprite(Sprite*, int, int);
   int renderCopySprite(std::string, int, int);
-  int renderCopyObject(std::shared_ptr<WorldObject>, int, int);
-  int renderCopyMobObject(std::shared_ptr<MobObject>, int, int);
-  int renderCopyTerrain(TerrainObject*, int, int);
+  int renderCopyObject(WorldObject*, int, int);
+  int renderCopyMobObject(MobObject*, int, int);
+  int renderCopyTerrain(const TerrainObject*, int, int, int, int);
+  int renderFillPlaceholder(int, int, int, int);
   int renderFillUIWindow(UIRect*);
 };
 
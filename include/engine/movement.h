@@ -11,7 +11,7 @@ struct controller::MovementController
   {
     this->e = e;
   }
-  void processMap(int);
+  void processMap();
   void scrollGameSurface (int);
 };
 
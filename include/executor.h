@@ -0,0 +1,104 @@
+#ifndef GAME_EXECUTOR_H
+#define GAME_EXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Engine-wide pool for CPU-bound work such as map generation. Anything that used to start a thread per piece
+// of work and join or detach it submits tasks here instead, grouped so the caller can wait for them.
+namespace executor
+{
+  typedef std::function<void()> Task;
+
+  // Each worker takes from the back of its own deque and, when that is empty, steals from the front of the
+  // others'. Tasks submitted from outside the pool are dealt out round robin.
+  struct Executor
+  {
+    struct Worker
+    {
+      std::deque<Task> tasks;
+      std::mutex workerMtx;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex sleepMtx;
+    std::condition_variable wake;
+    std::atomic<std::size_t> queued;
+    std::atomic<std::size_t> nextWorker;
+    bool stopping;
+    explicit Executor (std::size_t);
+    Executor (const Executor&) = delete;
+    ~Executor ();
+    // Index of the worker the calling thread is, or -1 if it isn't one of this pool's
+    int self ();
+    void submit (Task);
+    // Runs one queued task on the calling thread if there is any
+    bool runOne ();
+    void work (int);
+  };
+
+  // One worker per core, less the thread that submits work and helps run it while waiting
+  Executor& shared ();
+
+  // Tasks that can be waited for together. A thread waiting on a group runs queued tasks until the group is done,
+  // so groups can be waited on from inside the pool without tying up a worker.
+  struct TaskGroup
+  {
+    Executor& executor;
+    std::atomic<std::size_t> outstanding;
+    TaskGroup (Executor& executor = shared()) : executor(executor), outstanding(0) {}
+    TaskGroup (const TaskGroup&) = delete;
+    ~TaskGroup () { wait(); }
+    template <typename F>
+    void spawn (F f)
+    {
+      outstanding++;
+      executor.submit([this, f]() mutable {
+        f();
+        outstanding--;
+      });
+    }
+    void wait ()
+    {
+      while (outstanding.load() > 0)
+        if (!executor.runOne())
+          std::this_thread::yield();
+    }
+  };
+
+  // Calls f(i) for every i in [begin, end), grain at a time per task, and returns once all are done
+  template <typename F>
+  void parallelFor (int begin, int end, F f, int grain = 1)
+  {
+    TaskGroup group;
+    for (auto i = begin; i < end; i += grain)
+    {
+      int last = std::min(end, i + grain);
+      group.spawn([&f, i, last]() {
+        for (auto n = i; n < last; n++)
+          f(n);
+      });
+    }
+    group.wait();
+  }
+
+  // Calls f(x, y) for every tile of [x1, x2) x [y1, y2), a column per task
+  template <typename F>
+  void parallelFor (int x1, int y1, int x2, int y2, F f)
+  {
+    parallelFor(x1, x2, [&f, y1, y2](int x) {
+      for (auto y = y1; y < y2; y++)
+        f(x, y);
+    });
+  }
+}
+
+#endif
@@ -4,34 +4,101 @@
 #include "SDL2/SDL.h"
 #include "objects.h"
 #include "config.h"
+#include "executor.h"
 #include "rect.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <shared_mutex>
 #include <thread>
 #include <variant>
 
 #include "map/chunk/chunk.h"
+#include "map/chunk/region.h"
+#include "map/chunk/store.h"
 
 namespace map
 {
+  struct MapController;
+
+  // Generates chunk columns in the background on the shared executor, at most `limit` at a time, nearest the focus
+  // first. Requests for overlapping rects share the columns they have in common, and each request's future is ready
+  // once every one of its columns is in the map.
   struct MapGenerator
   {
-    bool processing;
-    MapGenerator () : processing(false){}
-    void init(std::shared_mutex* mtx)
+    struct Request
     {
-      mtx->lock();
-      processing = true;
-      mtx->unlock();
-    }
-    void reset(std::shared_mutex* mtx)
+      std::promise<void> done;
+      std::size_t outstanding;
+      bool cancelled;
+    };
+    struct Column
     {
-      mtx->lock();
-      processing = false;
-      mtx->unlock();
+      int cx;
+      int cy;
+      int priority;
+      int distance;
+      std::uint64_t order;
+      bool running;
+      std::vector<std::shared_ptr<Request>> waiting;
+    };
+    // Queued and running columns by column key
+    std::map<std::uint64_t, Column> columns;
+    // Queued columns, lowest priority number first, then nearest the focus, then first come, first served
+    std::set<std::tuple<int, int, std::uint64_t, std::uint64_t>> queue;
+    std::mutex generatorMtx;
+    std::condition_variable idle;
+    std::uint64_t requests;
+    std::size_t active;
+    std::size_t limit;
+    bool stopping;
+    // The chunk column queue distances are measured from
+    int focusX;
+    int focusY;
+    MapController* owner;
+    MapGenerator () : requests(0), active(0), limit(executor::shared().workers.size() + 1), stopping(false), focusX(0), focusY(0), owner(nullptr) {}
+    MapGenerator (MapGenerator&& other) : MapGenerator() { other.stop(); }
+    MapGenerator& operator= (MapGenerator&& other)
+    {
+      stop();
+      other.stop();
+      return *this;
     }
+    ~MapGenerator () { stop(); }
+    // True while any requested column is queued or being generated
+    bool processing () { std::unique_lock lock(generatorMtx); return columns.size() > 0; }
+    std::shared_future<void> request (MapController*, std::vector<std::pair<int, int>>&, int);
+    void enqueue (std::uint64_t, Column&);
+    // Reorders the queue around a new focus and cancels queued columns with a priority above 0 outside keep
+    std::size_t refocus (int, int, const Rect&);
+    void drain ();
+    // Lets running columns finish and drops queued ones; their requests' futures report a broken promise
+    void stop ();
+  };
+
+  // One tile change for MapController::updateTiles, which leaves biomeId holding the biome actually used
+  struct TileEdit
+  {
+    int z;
+    int x;
+    int y;
+    TypeId biomeId;
+    TypeId terrainId;
+  };
+
+  // A pooled world object or mob to put on a tile, for placeObjects and placeMobs
+  struct Placement
+  {
+    int z;
+    int x;
+    int y;
+    objects::Handle handle;
   };
 
   struct MapController
@@ -44,12 +111,24 @@ namespace map
     std::vector<std::string>* biomeTypeKeys;
     objects::terrainTypesMap* terrainTypes;
     objects::tileTypesMap* tileTypes;
-    objects::biomeMap biomeMap;
-    objects::terrainMap terrainMap;
-    objects::worldMap worldMap;
-    objects::mobMap mobMap;
+    map::chunk::ChunkStore chunks;
+    map::chunk::RegionStore regions;
     config::ConfigurationController* cfg;
+    std::uint64_t worldSeed;
+    // Set while this thread generates a chunk: reads outside it see nothing and writes outside it are dropped,
+    // so a chunk's content depends only on the world seed and its coordinates
+    static inline thread_local const Rect* generationBounds = nullptr;
+    static bool generating () { return generationBounds != nullptr; }
+    static bool outsideGeneration (int x, int y)
+    {
+      auto r = generationBounds;
+      return r != nullptr && (x < r->x1 || x > r->x2 || y < r->y1 || y > r->y2);
+    }
     MapController () : maxDepth(0) {}
+    MapController (MapController&&) = default;
+    MapController& operator= (MapController&&) = default;
+    // Generation in flight uses the chunk store, so it has to finish before the members go
+    ~MapController () { mapGenerator.stop(); }
     MapController (
         int d,
         objects::mobTypesMap* mTypes,
@@ -63,22 +142,63 @@ namespace map
     {
       maxDepth = d; mobTypes = mTypes; objectTypes = oTypes; biomeTypes = bTypes; biomeTypeKeys = bTypeKeys;
       terrainTypes = tnTypes; tileTypes = tlTypes; cfg = c;
+      chunks.configureResidency(static_cast<std::size_t>(cfg->memoryBudgetMB) << 20, cfg->chunkStorePath);
+      regions.open(cfg->worldPath);
+      worldSeed = regions.seed(cfg->worldSeed != 0 ? cfg->worldSeed : std::random_device()() * 0x100000001ull);
+    }
+    // With block false, tiles whose chunk is evicted to disk read as missing while it is loaded in the background
+    TerrainObject* findTerrain (int z, int x, int y, bool block = true)
+    {
+      return outsideGeneration(x, y) ? nullptr : chunks.findTerrain(z, x, y, block);
     }
-    bool isPassable (std::tuple<int, int, int>);
-    BiomeType* updateTile (int, int, int, BiomeType*, TerrainType*, std::vector<std::shared_ptr<WorldObject>>);
-    void updateTile (int, int, int, std::shared_ptr<WorldObject>, std::shared_ptr<MobObject>);
-    std::vector<std::shared_ptr<MobObject>>::iterator moveMob (std::string, std::tuple<int, int, int>, std::tuple<int, int, int>);
-    std::vector<std::shared_ptr<MobObject>>::iterator moveMob (std::vector<std::shared_ptr<MobObject>>::iterator, std::tuple<int, int, int>, int directions);
-    std::map<int, std::map<std::string, int>> getTilesInRange (Rect*);
-    std::map<int, std::map<std::string, std::map<std::string, int>>> getCountsInRange (Rect*);
-    std::map<int, std::map<std::string, int>> getBiomesInRange (Rect* rangeRect);
+    template <typename F> void forEachObject (int z, int x, int y, F f, bool block = true) { chunks.forEachObject(z, x, y, f, block); }
+    template <typename F> void forEachMob (int z, int x, int y, F f, bool block = true) { chunks.forEachMob(z, x, y, f, block); }
+    bool isPassable (std::tuple<int, int, int>, bool block = false);
+    std::uint8_t getPassableNeighbors (int z, int x, int y) { return chunks.passableNeighbors(z, x, y); }
+    void updatePassability (map::chunk::Chunk*, int);
+    TypeId updateTile (int, int, int, TypeId, TypeId);
+    TypeId updateTile (map::chunk::SlidingReport*, int, int, int, TypeId, TypeId);
+    template <typename T, typename F> void forEachByChunk (std::vector<T>&, F);
+    void resolveTileEdit (TileEdit&);
+    void setTile (map::chunk::Chunk*, int, TypeId, TypeId);
+    std::size_t updateTiles (std::vector<TileEdit>&);
+    std::size_t updateTiles (int, Rect*, TypeId, TypeId);
+    std::size_t updateTiles (map::chunk::SlidingReport*, std::vector<TileEdit>&);
+    void placeObject (int, int, int, objects::Handle);
+    void placeMob (int, int, int, objects::Handle);
+    void placeObjects (std::vector<Placement>&);
+    void placeMobs (std::vector<Placement>&);
+    objects::Handle createMob (int, int, int, MobType*, TypeId);
+    bool moveMob (objects::Handle, std::tuple<int, int, int>, std::tuple<int, int, int>);
+    void moveMob (objects::Handle, std::tuple<int, int, int>, int directions);
+    template <typename F, typename G> void accumulateRange (Rect*, F, G);
+    std::map<int, std::map<TypeId, int>> getTilesInRange (Rect*);
+    std::map<int, std::map<std::string, std::map<TypeId, int>>> getCountsInRange (Rect*);
+    std::map<int, std::map<TypeId, int>> getBiomesInRange (Rect* rangeRect);
     map::chunk::ChunkReport generateRangeReport(Rect*, int);
+    void countTileInReport(map::chunk::ChunkStore::CellReader&, map::chunk::ChunkReport*, int, int, bool);
+    void moveRangeReport(map::chunk::SlidingReport*, int, int);
     void processChunk(Rect*, std::function<void(int, int, int)>);
+    template<typename F> void processChunkWithReport(Rect*, int, F);
     template<typename F> void iterateOverChunk(Rect*, F);
     template<typename F> void iterateOverChunkEdges(Rect*, F);
     void randomlyAccessAllTilesInChunk(Rect*, std::function<void(int, int, int)>);
     std::map<int, std::vector<SDL_Point>> getAllPointsInRect(Rect*);
+    std::shared_future<void> requestChunks(Rect*, int priority = 0);
+    // True if any level of the column is in the chunk store
+    bool hasColumn (int, int);
+    std::size_t focusGeneration(int, int, Rect*);
     int generateMapChunk(Rect*);
+    void generateChunk(int, int);
+    template <typename F> bool changesSince (int z, int x, int y, std::uint64_t& v, F f) { return chunks.changesSince(z, x, y, v, f); }
+    void manageResidency (int x, int y) { chunks.manageResidency(x, y, cfg->residentRadius); }
+    // Renderer reads go through a snapshot of the map as of the last publishChunks, so they never wait on writers
+    map::chunk::ChunkStore::Snapshot snapshot () { return chunks.snapshot(); }
+    // Once per frame, before rendering
+    void publishChunks () { chunks.publish(); }
+    std::vector<std::uint8_t> encodeDelta (const map::chunk::Chunk&);
+    bool applyDelta (int, int, int, const std::uint8_t*, std::size_t);
+    std::size_t saveWorld ();
   };
 }
 
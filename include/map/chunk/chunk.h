@@ -4,6 +4,7 @@
 #include "SDL2/SDL.h"
 #include "objects.h"
 #include "rect.h"
+#include "rng.h"
 #include <functional>
 #include <mutex>
 #include <shared_mutex>
@@ -15,20 +16,70 @@ namespace map::chunk
 {
   struct ChunkProcessor;
   typedef std::function<void(int, int, int)> chunkFunctor;
-  typedef std::function<void(int, int, int, BiomeType*)> chunkProcessorFunctor;
-  typedef std::function<void(Rect*, BiomeType* b)> chunkProcessorCallbackFunctor;
-  typedef std::function<BiomeType*(ChunkProcessor*,int,std::tuple<int,int>)> chunkCallbackFn;
+  typedef std::function<void(int, int, int, TypeId)> chunkProcessorFunctor;
+  typedef std::function<void(Rect*, TypeId b)> chunkProcessorCallbackFunctor;
+  typedef std::function<TypeId(ChunkProcessor*,int,std::tuple<int,int>)> chunkCallbackFn;
   typedef std::variant<chunkFunctor, chunkProcessorFunctor, chunkProcessorCallbackFunctor> genericChunkFunctor;
   typedef std::vector<std::pair<genericChunkFunctor, chunkCallbackFn>> multiprocessFunctorVec;
   typedef std::array<multiprocessFunctorVec, 2> multiprocessFunctorArray;
 
+  // Histogram of the tiles in a window on one level. It is flat and fixed-size so a report can live on
+  // the stack of the per-tile generator callbacks; counts are 16-bit, which is plenty for neighborhood windows.
   struct ChunkReport
   {
-    std::map<int, std::map<std::string, int >> terrainCounts;
-    std::map<int, std::map<std::string, int >> biomeCounts;
-    std::map<int, std::tuple<int, std::string>> topTerrain;
-    std::map<int, std::tuple<int, std::string>> topBiome;
-    std::map<int, std::map<std::string, std::string>> meta;
+    int z;
+    std::array<std::uint16_t, MAX_TYPE_IDS> terrainCounts;
+    std::array<std::uint16_t, MAX_TYPE_IDS> biomeCounts;
+    std::tuple<int, TypeId> topTerrain;
+    std::tuple<int, TypeId> secondTopTerrain;
+    std::tuple<int, TypeId> topBiome;
+    std::tuple<int, TypeId> secondTopBiome;
+    ChunkReport (int z = 0) : z(z), topTerrain(0, NO_TYPE), secondTopTerrain(0, NO_TYPE), topBiome(0, NO_TYPE), secondTopBiome(0, NO_TYPE)
+    {
+      terrainCounts.fill(0);
+      biomeCounts.fill(0);
+    }
+    static void rank (int count, TypeId id, std::tuple<int, TypeId>& top, std::tuple<int, TypeId>& second)
+    {
+      if (std::get<1>(top) == id)
+        std::get<0>(top) = count;
+      else if (count > std::get<0>(top))
+      {
+        second = top;
+        top = { count, id };
+      }
+      else if (std::get<1>(second) == id || count > std::get<0>(second))
+        second = { count, id };
+    }
+    static void rerank (const std::array<std::uint16_t, MAX_TYPE_IDS>& counts, std::size_t n, std::tuple<int, TypeId>& top, std::tuple<int, TypeId>& second)
+    {
+      top = second = { 0, NO_TYPE };
+      for (std::size_t id = 0; id < n; id++)
+        if (counts[id] > 0)
+          rank(counts[id], static_cast<TypeId>(id), top, second);
+    }
+    void addTerrain (TypeId id) { rank(++terrainCounts[id], id, topTerrain, secondTopTerrain); }
+    void addBiome (TypeId id) { rank(++biomeCounts[id], id, topBiome, secondTopBiome); }
+    // Removals can demote the top entries, so callers rerank once they are done changing counts
+    void removeTerrain (TypeId id) { --terrainCounts[id]; }
+    void removeBiome (TypeId id) { --biomeCounts[id]; }
+    void rerank (std::size_t terrainTypes, std::size_t biomeTypes)
+    {
+      rerank(terrainCounts, terrainTypes, topTerrain, secondTopTerrain);
+      rerank(biomeCounts, biomeTypes, topBiome, secondTopBiome);
+    }
+  };
+
+  // A ChunkReport over [x - radius, x + radius) x [y - radius, y + radius) that is moved along a column one
+  // row at a time, so each step only counts the row entering and the row leaving the window
+  struct SlidingReport : ChunkReport
+  {
+    int radius;
+    int x;
+    int y;
+    bool placed;
+    SlidingReport (int z, int radius) : ChunkReport(z), radius(radius), x(0), y(0), placed(false) {}
+    bool contains (int z, int i, int j) { return placed && z == this->z && i >= x - radius && i < x + radius && j >= y - radius && j < y + radius; }
   };
 
   struct ChunkProcessor
@@ -36,22 +87,22 @@ namespace map::chunk
     Rect* chunk;
     std::vector<Rect>* smallchunks;
     int zMax;
-    BiomeType* brush;
+    TypeId brush;
     std::shared_mutex brushMtx;
-    ChunkProcessor (Rect* r, int zMax = 3)
+    ChunkProcessor (Rect* r, int zMax = 3, int divisions = 25)
     {
       chunk = r;
       bool shuffle = true;
-      smallchunks = r->getRects(shuffle);
+      smallchunks = r->getRects(shuffle, divisions);
       this->zMax = zMax;
     };
-    BiomeType* getBrush() { std::shared_lock lock(brushMtx); return brush; }
-    void setBrush(BiomeType* b)
+    TypeId getBrush() { std::shared_lock lock(brushMtx); return brush; }
+    void setBrush(TypeId b)
     {
       std::unique_lock lock(brushMtx);
       brush = b;
     }
-    void processEdges(Rect*, std::pair<chunkProcessorFunctor, BiomeType*>);
+    void processEdges(Rect*, std::pair<chunkProcessorFunctor, TypeId>);
     void multiProcess (Rect*, multiprocessFunctorArray, int);
     void lazyProcess (Rect* r, std::vector<chunkFunctor>, int);
     void process (Rect*, std::vector<chunkFunctor>);
@@ -60,7 +111,15 @@ namespace map::chunk
     void multiProcessChunk (multiprocessFunctorArray functors, int fuzz = 1) { multiProcess(chunk, functors, fuzz); }
   };
 
-  ChunkReport getRangeReport(std::function<void(int, int, ChunkReport*)>, Rect*, int, int);
+  template <typename F>
+  ChunkReport getRangeReport(F f, Rect* r, int z = 0, int fuzz = 1, int base = 1)
+  {
+    ChunkReport report (z);
+    for (auto i = r->x1; i < r->x2; i += fuzz > 1 ? base + rng::next() % fuzz : base)
+      for (auto j = r->y1; j < r->y2; j += fuzz > 1 ? base + rng::next() % fuzz : base)
+        f(i, j, &report);
+    return report;
+  }
 }
 
 #endif
\ No newline at end of file
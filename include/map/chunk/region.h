@@ -0,0 +1,156 @@
+#ifndef GAME_MAP_CHUNK_REGION_H
+#define GAME_MAP_CHUNK_REGION_H
+
+#include "SDL2/SDL.h"
+#include "map/chunk/store.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace map::chunk
+{
+  // A region file keeps what has changed in a REGION_SIZE x REGION_SIZE square of chunks on one level since they
+  // were generated; everything else is regenerated from the world seed. It has a header page holding the offset
+  // table, then each chunk's payload starting on a page of its own. Payloads are only ever appended, and a chunk
+  // is replaced by publishing a new table entry with a single aligned 64-bit store, so a reader sees either the
+  // old payload or the new one. Fields are stored in host byte order.
+  const int REGION_SHIFT = 4;
+  const int REGION_SIZE = 1 << REGION_SHIFT;
+  const int REGION_CHUNKS = REGION_SIZE * REGION_SIZE;
+  const std::size_t REGION_PAGE = 4096;
+  const std::uint32_t REGION_VERSION = 3;
+  const std::uint32_t REGION_MAGIC = 0x47455254; // "TREG"
+  const std::uint32_t PAYLOAD_MAGIC = 0x4C594150; // "PAYL"
+
+  struct RegionHeader
+  {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int32_t z;
+    std::int32_t rx;
+    std::int32_t ry;
+    std::uint32_t chunkSize;
+    std::uint32_t regionSize;
+    std::uint32_t reserved[9];
+    // Page of the payload << 32 | its length in bytes, or 0 for a chunk that was never written
+    std::uint64_t table[REGION_CHUNKS];
+  };
+  static_assert(sizeof(RegionHeader) <= REGION_PAGE && offsetof(RegionHeader, table) % 8 == 0);
+
+  struct PayloadHeader
+  {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t length;
+    std::uint32_t checksum;
+  };
+
+  // FNV-1a
+  inline std::uint32_t checksum (const std::uint8_t* p, std::size_t n)
+  {
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < n; i++)
+      h = (h ^ p[i]) * 16777619u;
+    return h;
+  }
+
+  struct PayloadWriter
+  {
+    std::vector<std::uint8_t> bytes;
+    void put (const void* p, std::size_t n)
+    {
+      auto b = static_cast<const std::uint8_t*>(p);
+      bytes.insert(bytes.end(), b, b + n);
+    }
+    template <typename T>
+    void put (const T& v) { put(&v, sizeof(T)); }
+  };
+
+  struct PayloadReader
+  {
+    const std::uint8_t* p;
+    const std::uint8_t* end;
+    bool get (void* v, std::size_t n)
+    {
+      if (static_cast<std::size_t>(end - p) < n)
+        return false;
+      std::memcpy(v, p, n);
+      p += n;
+      return true;
+    }
+    template <typename T>
+    bool get (T& v) { return get(&v, sizeof(T)); }
+  };
+
+  struct RegionFile
+  {
+    int fd = -1;
+    std::uint8_t* data = nullptr;
+    std::size_t mapped = 0;
+    std::size_t size = 0;
+    RegionFile () {}
+    RegionFile (const RegionFile&) = delete;
+    ~RegionFile ();
+    // Creates the file if it doesn't exist; nullptr if it can't be mapped or belongs to another region or version
+    static std::unique_ptr<RegionFile> open (const std::filesystem::path&, int z, int rx, int ry);
+    RegionHeader* header () { return reinterpret_cast<RegionHeader*>(data); }
+    bool remap ();
+    // Points into the mapping and stays valid until the next write; nullptr if the chunk is absent or corrupt
+    const std::uint8_t* read (int index, std::size_t& length);
+    // Appends every payload, syncs them, then publishes their table entries
+    bool write (const std::vector<std::pair<int, std::vector<std::uint8_t>>>&);
+  };
+
+  struct RegionStore
+  {
+    struct Payload
+    {
+      int z;
+      int cx;
+      int cy;
+      std::vector<std::uint8_t> bytes;
+    };
+    std::filesystem::path path;
+    // Regions that were looked up and had no file hold nullptr until something is written to them
+    std::map<std::uint64_t, std::unique_ptr<RegionFile>> regions;
+    std::mutex regionMtx;
+    RegionStore () {}
+    RegionStore (RegionStore&& other) { *this = std::move(other); }
+    RegionStore& operator= (RegionStore&& other)
+    {
+      std::unique_lock lock(regionMtx);
+      path = std::move(other.path);
+      other.path.clear();
+      regions = std::move(other.regions);
+      return *this;
+    }
+    // An empty path leaves persistence off
+    void open (const std::filesystem::path&);
+    // The seed the saved world was generated with, or fallback (recorded for next time) if there is none yet
+    std::uint64_t seed (std::uint64_t fallback);
+    static int index (int cx, int cy) { return ((cy & (REGION_SIZE - 1)) << REGION_SHIFT) | (cx & (REGION_SIZE - 1)); }
+    RegionFile* region (int z, int cx, int cy, bool create);
+    // Calls f(bytes, length) on the chunk's payload while it is mapped, returning what f returns, or false if
+    // the chunk was never saved
+    template <typename F>
+    bool read (int z, int cx, int cy, F f)
+    {
+      std::unique_lock lock(regionMtx);
+      auto r = region(z, cx, cy, false);
+      if (r == nullptr)
+        return false;
+      std::size_t length;
+      auto p = r->read(index(cx, cy), length);
+      return p != nullptr && f(p, length);
+    }
+    // Returns the number of payloads written
+    std::size_t write (std::vector<Payload>);
+  };
+}
+
+#endif
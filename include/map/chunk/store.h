@@ -0,0 +1,878 @@
+#ifndef GAME_MAP_CHUNK_STORE_H
+#define GAME_MAP_CHUNK_STORE_H
+
+#include "objects.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace map::chunk
+{
+  const int CHUNK_SHIFT = 5;
+  const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+  const int CHUNK_MASK = CHUNK_SIZE - 1;
+  const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+
+  // Arithmetic shift floors, so tile -1 lands in chunk -1 rather than chunk 0
+  inline int toChunkCoordinate (int n) { return n >> CHUNK_SHIFT; }
+  inline int toLocalIndex (int x, int y) { return ((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK); }
+
+  // Bits of ChunkStore::passableNeighbors, row by row from (x - 1, y - 1)
+  enum neighbors
+  {
+    NORTH_WEST  = 0x01,
+    NORTH       = 0x02,
+    NORTH_EAST  = 0x04,
+    WEST        = 0x08,
+    EAST        = 0x10,
+    SOUTH_WEST  = 0x20,
+    SOUTH       = 0x40,
+    SOUTH_EAST  = 0x80
+  };
+
+  // Interleaves the low 24 bits of v with zeros, so neighbouring chunks get nearby Morton codes
+  inline std::uint64_t spreadBits (std::uint32_t v)
+  {
+    std::uint64_t x = v & 0xFFFFFF;
+    x = (x | x << 16) & 0x0000FFFF0000FFFFull;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFull;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x << 2) & 0x3333333333333333ull;
+    x = (x | x << 1) & 0x5555555555555555ull;
+    return x;
+  }
+
+  // What has changed in a chunk since it was generated. Chunks without changes are dropped when far away and
+  // regenerated from the world seed; changed ones save their edited cells, and their object or mob lists if
+  // those changed.
+  struct ChunkDelta
+  {
+    std::bitset<CHUNK_AREA> edited;
+    bool objects = false;
+    bool mobs = false;
+    bool empty () const { return edited.none() && !objects && !mobs; }
+  };
+
+  enum changeLayer
+  {
+    TERRAIN_LAYER,
+    OBJECT_LAYER,
+    MOB_LAYER
+  };
+
+  enum changeKind
+  {
+    CHANGE_SET,
+    CHANGE_ADD,
+    CHANGE_REMOVE
+  };
+
+  struct Change
+  {
+    std::uint16_t tile;
+    std::uint8_t layer;
+    std::uint8_t kind;
+  };
+
+  // The last CAPACITY changes to a chunk, for caches that refresh only what changed. version counts every change
+  // ever recorded, and a version from before floor (the chunk was rebuilt from a packed or regenerated copy) or
+  // from before the oldest entry still held means the cache has to be rebuilt in full. Guarded by the chunk's
+  // cell lock like the cells it describes.
+  struct ChangeJournal
+  {
+    static const int CAPACITY = 64;
+    std::array<Change, CAPACITY> entries;
+    std::uint64_t version = 0;
+    std::uint64_t floor = 0;
+    void record (int tile, changeLayer layer, changeKind kind)
+    {
+      entries[version % CAPACITY] = { static_cast<std::uint16_t>(tile), static_cast<std::uint8_t>(layer), static_cast<std::uint8_t>(kind) };
+      version++;
+    }
+    // Starts over at v with nothing held, so every earlier version reads as too old
+    void restart (std::uint64_t v)
+    {
+      version = v;
+      floor = v;
+    }
+    // Calls f(const Change&) on every change after version since, oldest first; false, without calling f, if
+    // some of them are no longer held
+    template <typename F>
+    bool since (std::uint64_t v, F f) const
+    {
+      if (v > version || v < floor || version - v > CAPACITY)
+        return false;
+      for (; v < version; v++)
+        f(entries[v % CAPACITY]);
+      return true;
+    }
+  };
+
+  // How many of a chunk's generated tiles have each terrain and biome type, indexed by type id
+  struct TypeHistogram
+  {
+    std::vector<std::uint16_t> terrain;
+    std::vector<std::uint16_t> biome;
+    void add (const TerrainObject& t)
+    {
+      if (t.terrainId >= terrain.size())
+        terrain.resize(t.terrainId + 1);
+      if (t.biomeId >= biome.size())
+        biome.resize(t.biomeId + 1);
+      terrain[t.terrainId]++;
+      biome[t.biomeId]++;
+    }
+    void remove (const TerrainObject& t)
+    {
+      terrain[t.terrainId]--;
+      biome[t.biomeId]--;
+    }
+  };
+
+  struct ChunkView;
+
+  struct Chunk
+  {
+    int z;
+    int cx;
+    int cy;
+    std::bitset<CHUNK_AREA> generated;
+    // Generated and not blocked by terrain, objects or mobs; kept current by MapController::updatePassability
+    std::bitset<CHUNK_AREA> passable;
+    std::array<TerrainObject, CHUNK_AREA> terrain;
+    TypeHistogram histogram;
+    // Heads of each tile's list of pooled world objects and mobs
+    std::array<objects::Handle, CHUNK_AREA> objects;
+    std::array<objects::Handle, CHUNK_AREA> mobs;
+    // Residency clock tick of the last lookup that returned this chunk
+    std::atomic<std::uint32_t> lastAccess;
+    // Set by every change to a cell, cleared once the chunk is saved to its region file
+    std::atomic<bool> dirty;
+    ChunkDelta delta;
+    ChangeJournal journal;
+    // Changed since its last view was handed off; see ChunkStore::handOff
+    std::atomic<bool> unpublished;
+    Chunk (int z, int cx, int cy) : z(z), cx(cx), cy(cy), lastAccess(0), dirty(false), unpublished(false)
+    {
+      objects.fill(objects::NO_HANDLE);
+      mobs.fill(objects::NO_HANDLE);
+    }
+    // Every write of a cell's terrain goes through here, so the histogram stays exact
+    void setTerrain (int i, const TerrainObject& t)
+    {
+      if (generated[i])
+        histogram.remove(terrain[i]);
+      terrain[i] = t;
+      generated[i] = true;
+      histogram.add(t);
+    }
+  };
+
+  // Cold form of a Chunk: its distinct cells in a palette, one palette index per tile (bit-packed, or as runs
+  // when that is smaller) and only the tiles that head an object or mob list
+  struct PackedChunk
+  {
+    struct Cell
+    {
+      TerrainObject terrain;
+      bool generated;
+      bool passable;
+      bool operator== (const Cell& o) const
+      {
+        return terrain.biomeId == o.terrain.biomeId && terrain.terrainId == o.terrain.terrainId
+          && terrain.initialized == o.terrain.initialized && generated == o.generated && passable == o.passable;
+      }
+    };
+    static const std::size_t MAX_PALETTE = 256;
+    int z;
+    int cx;
+    int cy;
+    std::vector<Cell> palette;
+    // Bits per packed index; 0 means indices holds runs of (length << 16 | palette index)
+    int bits;
+    std::vector<std::uint32_t> indices;
+    std::vector<std::pair<std::uint16_t, objects::Handle>> objects;
+    std::vector<std::pair<std::uint16_t, objects::Handle>> mobs;
+    std::size_t generatedCount;
+    TypeHistogram histogram;
+    std::uint32_t lastAccess;
+    bool dirty;
+    ChunkDelta delta;
+    // Only the journal's version survives packing
+    std::uint64_t version;
+    // Returns nullptr when the chunk has too many distinct cells to be worth packing
+    static std::unique_ptr<PackedChunk> pack (const Chunk&);
+    std::unique_ptr<Chunk> unpack () const;
+    std::size_t bytes () const;
+    bool write (const std::filesystem::path&) const;
+    static std::unique_ptr<PackedChunk> read (const std::filesystem::path&);
+  };
+
+  // Flat open-addressing table from chunk key to chunk. Keys are Z-ordered, and a key's home slot is its
+  // low bits, so chunks that are close on the map sit in nearby slots and a view rectangle probes few cache lines.
+  struct ChunkDirectory
+  {
+    static constexpr std::uint64_t EMPTY = ~0ull;
+    // An occupied slot holds its chunk dense, packed, or evicted to disk; exactly one of the three
+    struct Slot
+    {
+      std::uint64_t key = EMPTY;
+      int z = 0;
+      int cx = 0;
+      int cy = 0;
+      std::unique_ptr<Chunk> chunk;
+      std::unique_ptr<PackedChunk> packed;
+      bool evicted = false;
+      std::size_t evictedTiles = 0;
+      // Kept in memory so range statistics don't have to load evicted chunks
+      TypeHistogram evictedHistogram;
+      std::uint64_t evictedVersion = 0;
+    };
+    std::vector<Slot> slots;
+    std::size_t count = 0;
+    ChunkDirectory () : slots(64) {}
+    static std::uint64_t hash (std::uint64_t key) { return key ^ (key >> 48) * 0x9E3779B97F4A7C15ull; }
+    std::size_t home (std::uint64_t key) { return hash(key) & (slots.size() - 1); }
+    Slot* find (std::uint64_t key)
+    {
+      if (slots.empty())
+        return nullptr;
+      for (auto i = home(key); ; i = (i + 1) & (slots.size() - 1))
+      {
+        if (slots[i].key == key)
+          return &slots[i];
+        if (slots[i].key == EMPTY)
+          return nullptr;
+      }
+    }
+    Chunk* insert (std::uint64_t key, std::unique_ptr<Chunk> chunk)
+    {
+      if ((count + 1) * 2 > slots.size())
+      {
+        std::vector<Slot> old (std::max<std::size_t>(slots.size() * 2, 64));
+        old.swap(slots);
+        for (auto& s : old)
+          if (s.key != EMPTY)
+            place(std::move(s));
+      }
+      count++;
+      Slot s;
+      s.key = key;
+      s.z = chunk->z;
+      s.cx = chunk->cx;
+      s.cy = chunk->cy;
+      s.chunk = std::move(chunk);
+      return place(std::move(s))->chunk.get();
+    }
+    // Backward-shift deletion, so probes never need tombstones
+    void erase (Slot* s)
+    {
+      auto mask = slots.size() - 1;
+      auto i = static_cast<std::size_t>(s - slots.data());
+      slots[i] = Slot();
+      count--;
+      for (auto j = (i + 1) & mask; slots[j].key != EMPTY; j = (j + 1) & mask)
+      {
+        auto h = home(slots[j].key);
+        bool between = i < j ? (h > i && h <= j) : (h > i || h <= j);
+        if (between)
+          continue;
+        slots[i] = std::move(slots[j]);
+        slots[j] = Slot();
+        i = j;
+      }
+    }
+    Slot* place (Slot&& s)
+    {
+      auto i = home(s.key);
+      while (slots[i].key != EMPTY)
+        i = (i + 1) & (slots.size() - 1);
+      slots[i] = std::move(s);
+      return &slots[i];
+    }
+    template <typename F>
+    void forEach (F f)
+    {
+      for (auto& s : slots)
+        if (s.key != EMPTY)
+          f(s);
+    }
+  };
+
+  // Immutable copy of a dense chunk as its last writer left it. Object and mob lists are flattened to
+  // (tile, handle) pairs sorted by tile, in list order within a tile.
+  struct ChunkView
+  {
+    typedef std::vector<std::pair<std::uint16_t, objects::Handle>> HandleList;
+    std::bitset<CHUNK_AREA> generated;
+    std::bitset<CHUNK_AREA> passable;
+    std::array<TerrainObject, CHUNK_AREA> terrain;
+    HandleList objects;
+    HandleList mobs;
+    template <typename F>
+    static void forEachAt (const HandleList& list, int i, F f)
+    {
+      auto it = std::lower_bound(list.begin(), list.end(), i, [](const auto& e, int i) { return e.first < i; });
+      for (; it != list.end() && it->first == i; it++)
+        f(it->second);
+    }
+  };
+
+  // Published views by chunk key, probed like ChunkDirectory. A table is never changed once published: publish
+  // copies the last one and changes the copy, sharing the views of chunks that haven't changed.
+  struct ViewTable
+  {
+    std::vector<std::uint64_t> keys;
+    std::vector<std::shared_ptr<const ChunkView>> views;
+    std::size_t count;
+    explicit ViewTable (std::size_t n) : count(0)
+    {
+      std::size_t size = 64;
+      while (size < n * 2)
+        size *= 2;
+      keys.assign(size, ChunkDirectory::EMPTY);
+      views.resize(size);
+    }
+    std::size_t slot (std::uint64_t key) const
+    {
+      auto i = ChunkDirectory::hash(key) & (keys.size() - 1);
+      while (keys[i] != key && keys[i] != ChunkDirectory::EMPTY)
+        i = (i + 1) & (keys.size() - 1);
+      return i;
+    }
+    // Replaces the key's view if it has one; kept at most half full
+    void insert (std::uint64_t key, std::shared_ptr<const ChunkView> view)
+    {
+      auto i = slot(key);
+      if (keys[i] == ChunkDirectory::EMPTY && (count + 1) * 2 > keys.size())
+      {
+        ViewTable grown (count + 1);
+        for (std::size_t n = 0; n < keys.size(); n++)
+          if (keys[n] != ChunkDirectory::EMPTY)
+            grown.insert(keys[n], std::move(views[n]));
+        *this = std::move(grown);
+        i = slot(key);
+      }
+      count += keys[i] == ChunkDirectory::EMPTY;
+      keys[i] = key;
+      views[i] = std::move(view);
+    }
+    // Shifts later entries of the probe run back into the gap, so lookups never need tombstones
+    void erase (std::uint64_t key)
+    {
+      auto mask = keys.size() - 1;
+      auto i = slot(key);
+      if (keys[i] == ChunkDirectory::EMPTY)
+        return;
+      for (auto j = (i + 1) & mask; keys[j] != ChunkDirectory::EMPTY; j = (j + 1) & mask)
+      {
+        auto home = ChunkDirectory::hash(keys[j]) & mask;
+        // Entry j may move to i only if its home isn't cyclically within (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+          keys[i] = keys[j];
+          views[i] = std::move(views[j]);
+          i = j;
+        }
+      }
+      keys[i] = ChunkDirectory::EMPTY;
+      views[i].reset();
+      count--;
+    }
+    const ChunkView* find (std::uint64_t key) const
+    {
+      for (auto i = ChunkDirectory::hash(key) & (keys.size() - 1); ; i = (i + 1) & (keys.size() - 1))
+      {
+        if (keys[i] == key)
+          return views[i].get();
+        if (keys[i] == ChunkDirectory::EMPTY)
+          return nullptr;
+      }
+    }
+  };
+
+  // Epoch-based reclamation of replaced view tables. A reader announces the epoch it entered in before loading
+  // the table; a table retired in epoch e is deleted once every announced epoch is later than e. Readers never
+  // block and never touch a reference count.
+  struct Reclaimer
+  {
+    static const int READER_SLOTS = 64;
+    std::atomic<std::uint64_t> epoch;
+    // 0 for a free slot, otherwise the epoch its reader entered in
+    std::array<std::atomic<std::uint64_t>, READER_SLOTS> readers;
+    // Only touched by the publisher
+    std::vector<std::pair<std::uint64_t, std::unique_ptr<const ViewTable>>> retired;
+    Reclaimer () : epoch(1)
+    {
+      for (auto& r : readers)
+        r = 0;
+    }
+    // Only waits if every slot is taken
+    int enter ()
+    {
+      for (auto i = 0; ; i = (i + 1) % READER_SLOTS)
+      {
+        std::uint64_t free = 0;
+        if (readers[i].load(std::memory_order_relaxed) == 0 && readers[i].compare_exchange_strong(free, epoch.load()))
+          return i;
+      }
+    }
+    void exit (int slot) { readers[slot].store(0, std::memory_order_release); }
+    void retire (const ViewTable* t) { retired.push_back({ epoch.fetch_add(1), std::unique_ptr<const ViewTable>(t) }); }
+    void collect ();
+  };
+
+  // Lock ordering: a chunk's cell lock is taken before directoryMtx, and two cell locks lowest stripe first (see
+  // lockCells). Code holding directoryMtx may only try_lock a cell lock, skipping the chunk if it is busy.
+  struct ChunkStore
+  {
+    ChunkDirectory chunks;
+    std::shared_mutex directoryMtx;
+    // A chunk's cells, its list heads and the links of the objects on those lists are guarded by one of these,
+    // picked by chunk key so that neighbouring chunks never share one. Writers hold it exclusively around both
+    // the lookup and the change; reads of single cells hold it shared.
+    static const int LOCK_STRIPES = 64;
+    std::array<std::shared_mutex, LOCK_STRIPES> cellLocks;
+    // Distinguishes this store's current chunk pointers from stale ones in the per-thread last-hit cache;
+    // renewed whenever dense chunks are freed
+    std::atomic<std::uint64_t> epoch;
+    // Advanced once per manageResidency call; chunks remember the tick they were last looked up on
+    std::atomic<std::uint32_t> clock;
+    objects::ObjectPool<WorldObject> worldObjects;
+    objects::ObjectPool<MobObject> mobObjects;
+    // Bytes of chunk data to keep in memory, 0 for no limit; chunks over it are evicted to evictionPath
+    std::size_t memoryBudget;
+    std::filesystem::path evictionPath;
+    std::thread loader;
+    std::mutex loaderMtx;
+    std::condition_variable loaderCv;
+    std::deque<std::uint64_t> faultQueue;
+    std::set<std::uint64_t> faultsPending;
+    bool stopping;
+    // The table snapshot readers start from
+    std::atomic<const ViewTable*> views;
+    // Views handed off since the last publish, oldest first; a null view withdraws a chunk that stopped being
+    // dense. handOffMtx is taken last and nothing else is locked while it is held.
+    std::mutex handOffMtx;
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<const ChunkView>>> handedOff;
+    Reclaimer reclaimer;
+    // Each new chunk's journal starts 2^32 versions past the last one's, so a chunk that is dropped and
+    // regenerated never repeats a version a cache may have recorded for it
+    std::atomic<std::uint64_t> journals;
+    std::uint64_t nextJournalBase () { return ++journals << 32; }
+    // Columns being generated, which hold chunk and tile pointers without a cell lock; guarded by directoryMtx.
+    // dropUnchanged and packDistant leave them alone until generation unpins them.
+    std::set<std::pair<int, int>> pinned;
+    void pin (int cx, int cy) { std::unique_lock lock(directoryMtx); pinned.insert({ cx, cy }); }
+    void unpin (int cx, int cy) { std::unique_lock lock(directoryMtx); pinned.erase({ cx, cy }); }
+    bool isPinned (const ChunkDirectory::Slot& s) const { return pinned.count({ s.cx, s.cy }) > 0; }
+    static std::uint64_t nextEpoch ()
+    {
+      static std::atomic<std::uint64_t> epochs (1);
+      return epochs++;
+    }
+    ChunkStore () : epoch(nextEpoch()), clock(0), memoryBudget(0), stopping(false), views(nullptr), journals(0) {}
+    ChunkStore (ChunkStore&& other) : epoch(nextEpoch()), clock(0), memoryBudget(0), stopping(false), views(nullptr),
+      journals(0) { *this = std::move(other); }
+    ChunkStore& operator= (ChunkStore&& other)
+    {
+      stopLoader();
+      other.stopLoader();
+      std::unique_lock lock(directoryMtx);
+      chunks = std::move(other.chunks);
+      epoch = nextEpoch();
+      other.epoch = nextEpoch();
+      clock = other.clock.load();
+      journals = other.journals.load();
+      worldObjects = std::move(other.worldObjects);
+      mobObjects = std::move(other.mobObjects);
+      memoryBudget = other.memoryBudget;
+      evictionPath = std::move(other.evictionPath);
+      other.evictionPath.clear();
+      // Only done before anything reads snapshots; the next publish lists every dense chunk afresh
+      delete views.exchange(nullptr);
+      delete other.views.exchange(nullptr);
+      handedOff.clear();
+      other.handedOff.clear();
+      chunks.forEach([this](ChunkDirectory::Slot& s) {
+        if (s.chunk != nullptr)
+          handedOff.push_back({ s.key, makeView(*s.chunk) });
+      });
+      return *this;
+    }
+    ~ChunkStore ();
+    void configureResidency (std::size_t, const std::filesystem::path&);
+    static std::uint64_t key (int z, int cx, int cy)
+    {
+      const std::uint32_t bias = 1u << 23;
+      return (static_cast<std::uint64_t>(static_cast<std::uint16_t>(z)) << 48)
+        | spreadBits(static_cast<std::uint32_t>(cx) + bias)
+        | (spreadBits(static_cast<std::uint32_t>(cy) + bias) << 1);
+    }
+    static int stripe (std::uint64_t k) { return ChunkDirectory::hash(k) & (LOCK_STRIPES - 1); }
+    std::shared_mutex& cellLock (int z, int x, int y)
+    {
+      return cellLocks[stripe(key(z, toChunkCoordinate(x), toChunkCoordinate(y)))];
+    }
+    // Exclusive locks on the chunks of two tiles, taken lowest stripe first; the second is empty if they share one
+    std::pair<std::unique_lock<std::shared_mutex>, std::unique_lock<std::shared_mutex>> lockCells (int z1, int x1, int y1, int z2, int x2, int y2)
+    {
+      auto a = stripe(key(z1, toChunkCoordinate(x1), toChunkCoordinate(y1)));
+      auto b = stripe(key(z2, toChunkCoordinate(x2), toChunkCoordinate(y2)));
+      if (a > b)
+        std::swap(a, b);
+      std::unique_lock first (cellLocks[a]);
+      if (a == b)
+        return { std::move(first), std::unique_lock<std::shared_mutex>() };
+      return { std::move(first), std::unique_lock(cellLocks[b]) };
+    }
+    // For scans reading many neighbouring cells: holds one cell lock shared at a time, and only trades it for
+    // another when a read moves to a chunk on a different stripe
+    struct CellReader
+    {
+      ChunkStore& store;
+      int held;
+      std::shared_lock<std::shared_mutex> lock;
+      CellReader (ChunkStore& store) : store(store), held(-1) {}
+      void at (int z, int x, int y)
+      {
+        auto i = stripe(key(z, toChunkCoordinate(x), toChunkCoordinate(y)));
+        if (i == held)
+          return;
+        if (lock)
+          lock.unlock();
+        lock = std::shared_lock(store.cellLocks[i]);
+        held = i;
+      }
+      // Before anything that takes a cell lock of its own
+      void release ()
+      {
+        if (lock)
+          lock.unlock();
+        held = -1;
+      }
+    };
+    // Dense chunks are only freed under a renewed epoch, so a cached pointer is valid while the epoch matches
+    struct LastHit
+    {
+      std::uint64_t epoch = 0;
+      std::uint64_t key = ChunkDirectory::EMPTY;
+      Chunk* chunk = nullptr;
+    };
+    static LastHit& lastHit ()
+    {
+      thread_local LastHit hit;
+      return hit;
+    }
+    void touch (Chunk* c)
+    {
+      auto t = clock.load(std::memory_order_relaxed);
+      if (c->lastAccess.load(std::memory_order_relaxed) != t)
+        c->lastAccess.store(t, std::memory_order_relaxed);
+    }
+    // With block false an evicted chunk is queued for loading and reported missing instead of read from disk,
+    // which is what the renderer wants
+    Chunk* find (int z, int x, int y, bool block = true)
+    {
+      auto k = key(z, toChunkCoordinate(x), toChunkCoordinate(y));
+      auto& hit = lastHit();
+      if (hit.key == k && hit.epoch == epoch)
+      {
+        touch(hit.chunk);
+        return hit.chunk;
+      }
+      {
+        std::shared_lock lock(directoryMtx);
+        auto s = chunks.find(k);
+        if (s == nullptr)
+          return nullptr;
+        if (s->chunk != nullptr)
+        {
+          hit = { epoch, k, s->chunk.get() };
+          touch(s->chunk.get());
+          return s->chunk.get();
+        }
+        if (s->evicted && block == false)
+        {
+          lock.unlock();
+          requestFaultIn(k);
+          return nullptr;
+        }
+      }
+      return unpack(k);
+    }
+    Chunk* unpack (std::uint64_t);
+    std::filesystem::path pathFor (std::uint64_t k) { return evictionPath / (std::to_string(k) + ".chunk"); }
+    void requestFaultIn (std::uint64_t);
+    void runLoader ();
+    void stopLoader ();
+    static int distance (const ChunkDirectory::Slot& s, int x, int y)
+    {
+      int x1 = s.cx << CHUNK_SHIFT;
+      int y1 = s.cy << CHUNK_SHIFT;
+      int dx = std::max({ x1 - x, x - (x1 + CHUNK_MASK), 0 });
+      int dy = std::max({ y1 - y, y - (y1 + CHUNK_MASK), 0 });
+      return std::max(dx, dy);
+    }
+    // Packs every dense chunk lying entirely farther than radius tiles from (x, y) on any level, except those
+    // being written to or generated. Chunk pointers obtained outside a cell lock must not be used after this call.
+    std::size_t packDistant (int x, int y, int radius)
+    {
+      std::unique_lock lock(directoryMtx);
+      std::vector<std::uint64_t> packed;
+      chunks.forEach([this, &packed, x, y, radius](ChunkDirectory::Slot& s) {
+        if (s.chunk == nullptr || distance(s, x, y) <= radius || isPinned(s))
+          return;
+        std::unique_lock cell (cellLocks[stripe(s.key)], std::try_to_lock);
+        if (!cell)
+          return;
+        if (auto p = PackedChunk::pack(*s.chunk))
+        {
+          s.packed = std::move(p);
+          s.chunk.reset();
+          packed.push_back(s.key);
+        }
+      });
+      if (packed.size())
+      {
+        epoch = nextEpoch();
+        withdraw(packed);
+      }
+      return packed.size();
+    }
+    bool contains (int z, int cx, int cy)
+    {
+      std::shared_lock lock(directoryMtx);
+      return chunks.find(key(z, cx, cy)) != nullptr;
+    }
+    // Takes a chunk built elsewhere, such as one loaded from a region file; nullptr if its slot is already taken
+    Chunk* adopt (std::unique_ptr<Chunk> chunk)
+    {
+      auto k = key(chunk->z, chunk->cx, chunk->cy);
+      std::unique_lock lock(directoryMtx);
+      if (chunks.find(k) != nullptr)
+        return nullptr;
+      return chunks.insert(k, std::move(chunk));
+    }
+    // Calls f(const Chunk&) on every chunk changed since it was last saved, unpacking packed and evicted chunks
+    // into temporary copies. Evicted chunks keep their dirty mark on disk and are passed again next time, as are
+    // chunks being written to, whose cell lock is busy.
+    template <typename F>
+    std::size_t forEachDirty (F f)
+    {
+      std::unique_lock lock(directoryMtx);
+      std::size_t n = 0;
+      chunks.forEach([this, &f, &n](ChunkDirectory::Slot& s) {
+        std::unique_lock cell (cellLocks[stripe(s.key)], std::try_to_lock);
+        if (!cell)
+          return;
+        if (s.chunk != nullptr && s.chunk->dirty)
+        {
+          f(static_cast<const Chunk&>(*s.chunk));
+          s.chunk->dirty = false;
+        }
+        else if (s.packed != nullptr && s.packed->dirty)
+        {
+          f(static_cast<const Chunk&>(*s.packed->unpack()));
+          s.packed->dirty = false;
+        }
+        else if (s.evicted)
+        {
+          auto p = PackedChunk::read(pathFor(s.key));
+          if (p == nullptr || !p->dirty)
+            return;
+          f(static_cast<const Chunk&>(*p->unpack()));
+        }
+        else
+          return;
+        n++;
+      });
+      return n;
+    }
+    std::size_t dropUnchanged (int, int, int);
+    // Once per frame: drops distant unchanged chunks, packs the other distant ones, evicts the least recently
+    // used of those while over budget, and starts loading evicted chunks the camera has come back within radius of
+    void manageResidency (int, int, int);
+    Chunk* findOrCreate (int z, int x, int y)
+    {
+      if (auto c = find(z, x, y))
+        return c;
+      int cx = toChunkCoordinate(x);
+      int cy = toChunkCoordinate(y);
+      auto k = key(z, cx, cy);
+      std::unique_lock lock(directoryMtx);
+      if (chunks.find(k) != nullptr)
+      {
+        lock.unlock();
+        return unpack(k);
+      }
+      auto c = chunks.insert(k, std::make_unique<Chunk>(z, cx, cy));
+      c->journal.restart(nextJournalBase());
+      lastHit() = { epoch, k, c };
+      touch(c);
+      return c;
+    }
+    TerrainObject* findTerrain (int z, int x, int y, bool block = true)
+    {
+      auto c = find(z, x, y, block);
+      int i = toLocalIndex(x, y);
+      return c != nullptr && c->generated[i] ? &c->terrain[i] : nullptr;
+    }
+    objects::Handle& getObjects (int z, int x, int y) { return findOrCreate(z, x, y)->objects[toLocalIndex(x, y)]; }
+    objects::Handle& getMobs (int z, int x, int y) { return findOrCreate(z, x, y)->mobs[toLocalIndex(x, y)]; }
+    // A tile whose chunk is evicted to disk reads as impassable while it is loaded in the background; only with
+    // block true is it read from disk, under the cell lock, before answering
+    bool isPassable (int z, int x, int y, bool block = false)
+    {
+      std::shared_lock lock(cellLock(z, x, y));
+      auto c = find(z, x, y, block);
+      return c != nullptr && c->passable[toLocalIndex(x, y)];
+    }
+    std::uint8_t passableNeighbors (int z, int x, int y)
+    {
+      std::uint8_t mask = 0;
+      int bit = 0;
+      Chunk* c = nullptr;
+      std::shared_lock<std::shared_mutex> lock;
+      int lastCx = toChunkCoordinate(x - 1) - 1;
+      int lastCy = 0;
+      for (auto j = y - 1; j <= y + 1; j++)
+        for (auto i = x - 1; i <= x + 1; i++)
+        {
+          if (i == x && j == y)
+            continue;
+          int cx = toChunkCoordinate(i);
+          int cy = toChunkCoordinate(j);
+          if (cx != lastCx || cy != lastCy)
+          {
+            // Released before the next is taken, since only lockCells may hold two
+            if (lock)
+              lock.unlock();
+            lock = std::shared_lock(cellLock(z, i, j));
+            c = find(z, i, j);
+            lastCx = cx;
+            lastCy = cy;
+          }
+          if (c != nullptr && c->passable[toLocalIndex(i, j)])
+            mask |= 1 << bit;
+          bit++;
+        }
+      return mask;
+    }
+    // f runs under the chunk's cell lock held shared, so it must not change the map
+    template <typename F>
+    void forEachObject (int z, int x, int y, F f, bool block = true)
+    {
+      std::shared_lock cell (cellLock(z, x, y));
+      if (auto c = find(z, x, y, block))
+        worldObjects.forEach(c->objects[toLocalIndex(x, y)], f);
+    }
+    template <typename F>
+    void forEachMob (int z, int x, int y, F f, bool block = true)
+    {
+      std::shared_lock cell (cellLock(z, x, y));
+      if (auto c = find(z, x, y, block))
+        mobObjects.forEach(c->mobs[toLocalIndex(x, y)], f);
+    }
+    // Passes f(const Change&) every change to the chunk holding (x, y) made after version v, then sets v to the
+    // chunk's current version. False if the changes aren't all known, or there is no such chunk, and whatever was
+    // built from the chunk must be rebuilt; chunks that are packed or evicted only know whether they changed at
+    // all. f runs under the chunk's cell lock and must not touch the map.
+    template <typename F>
+    bool changesSince (int z, int x, int y, std::uint64_t& v, F f)
+    {
+      std::shared_lock cell (cellLock(z, x, y));
+      std::shared_lock lock (directoryMtx);
+      auto s = chunks.find(key(z, toChunkCoordinate(x), toChunkCoordinate(y)));
+      if (s == nullptr)
+        return false;
+      auto current = s->chunk != nullptr ? s->chunk->journal.version : s->packed != nullptr ? s->packed->version : s->evictedVersion;
+      bool complete = s->chunk != nullptr ? s->chunk->journal.since(v, f) : v == current;
+      v = current;
+      return complete;
+    }
+    // Calls f(const TypeHistogram&) for the chunk at chunk coordinates (cx, cy) if there is one
+    template <typename F>
+    void histogram (int z, int cx, int cy, F f)
+    {
+      std::shared_lock cell (cellLocks[stripe(key(z, cx, cy))]);
+      std::shared_lock lock (directoryMtx);
+      auto s = chunks.find(key(z, cx, cy));
+      if (s != nullptr)
+        f(s->chunk != nullptr ? s->chunk->histogram : s->packed != nullptr ? s->packed->histogram : s->evictedHistogram);
+    }
+    std::shared_ptr<const ChunkView> makeView (const Chunk&);
+    // Writers call this on the chunks they changed before releasing their cell locks. A chunk changed since its
+    // last view gets a new one, queued together with the other's so that a change spanning two chunks is
+    // published whole.
+    void handOff (Chunk*, Chunk* = nullptr);
+    // Called under directoryMtx by whatever stops chunks being dense, before they can be unpacked again
+    void withdraw (const std::vector<std::uint64_t>&);
+    // Swaps in a table with the views handed off since the last call; nothing but the hand-off queue is locked
+    void publish ();
+    // A wait-free, consistent read of the chunks as last published, for the renderer. The tables it pins stay
+    // allocated until it is destroyed, so keep one for no longer than a frame.
+    struct Snapshot
+    {
+      ChunkStore& store;
+      int slot;
+      const ViewTable* table;
+      Snapshot (ChunkStore& store) : store(store), slot(store.reclaimer.enter()), table(store.views.load()) {}
+      Snapshot (const Snapshot&) = delete;
+      ~Snapshot () { store.reclaimer.exit(slot); }
+      const ChunkView* find (int z, int x, int y) const
+      {
+        return table != nullptr ? table->find(key(z, toChunkCoordinate(x), toChunkCoordinate(y))) : nullptr;
+      }
+      const TerrainObject* findTerrain (int z, int x, int y) const
+      {
+        auto v = find(z, x, y);
+        int i = toLocalIndex(x, y);
+        return v != nullptr && v->generated[i] ? &v->terrain[i] : nullptr;
+      }
+      // Objects destroyed since publishing are skipped
+      template <typename F>
+      void forEachObject (int z, int x, int y, F f) const
+      {
+        if (auto v = find(z, x, y))
+          ChunkView::forEachAt(v->objects, toLocalIndex(x, y), [this, &f](objects::Handle h) {
+            if (auto o = store.worldObjects.get(h))
+              f(h, o);
+          });
+      }
+      template <typename F>
+      void forEachMob (int z, int x, int y, F f) const
+      {
+        if (auto v = find(z, x, y))
+          ChunkView::forEachAt(v->mobs, toLocalIndex(x, y), [this, &f](objects::Handle h) {
+            if (auto m = store.mobObjects.get(h))
+              f(h, m);
+          });
+      }
+    };
+    Snapshot snapshot () { return Snapshot(*this); }
+    std::tuple<std::size_t, std::size_t, std::size_t> countTiles ()
+    {
+      std::shared_lock lock(directoryMtx);
+      std::size_t t = 0;
+      chunks.forEach([&t](ChunkDirectory::Slot& s) {
+        t += s.chunk != nullptr ? s.chunk->generated.count() : s.packed != nullptr ? s.packed->generatedCount : s.evictedTiles;
+      });
+      return { t, worldObjects.live.load(), mobObjects.live.load() };
+    }
+  };
+}
+
+#endif
@@ -1,222 +1,411 @@
 #ifndef GAME_MAP_GENERATORS_H
 #define GAME_MAP_GENERATORS_H
 
+#include "executor.h"
 #include "map.h"
 
 using namespace map;
 
-int MapController::generateMapChunk(Rect* chunkRect)
+std::shared_future<void> MapGenerator::request (MapController* m, std::vector<std::pair<int, int>>& wanted, int priority)
 {
-  if (mapGenerator.processing)
+  auto r = std::make_shared<Request>();
+  r->outstanding = 0;
+  r->cancelled = false;
+  auto done = r->done.get_future().share();
+  std::size_t spawn = 0;
   {
-    std::unique_lock lock(mtx);
-    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "Already processing chunk.");
-    return -1;
+    std::unique_lock lock(generatorMtx);
+    owner = m;
+    for (auto [cx, cy] : wanted)
+    {
+      auto k = map::chunk::ChunkStore::key(0, cx, cy);
+      auto it = columns.find(k);
+      // Checked under generatorMtx: a column leaves columns only once it is generated, so one with chunks in the
+      // store and no entry here is finished rather than part way through
+      if (it == columns.end() && m->hasColumn(cx, cy))
+        continue;
+      if (it == columns.end())
+      {
+        it = columns.emplace(k, Column { cx, cy, priority, 0, requests++, false, {} }).first;
+        enqueue(k, it->second);
+      }
+      else if (!it->second.running && priority < it->second.priority)
+      {
+        queue.erase({ it->second.priority, it->second.distance, it->second.order, k });
+        it->second.priority = priority;
+        enqueue(k, it->second);
+      }
+      it->second.waiting.push_back(r);
+      r->outstanding++;
+    }
+    if (r->outstanding == 0)
+      r->done.set_value();
+    while (!stopping && active < limit && active < queue.size())
+    {
+      active++;
+      spawn++;
+    }
   }
+  for (std::size_t n = 0; n < spawn; n++)
+    executor::shared().submit([this]() { drain(); });
+  return done;
+}
 
-  mapGenerator.init(&mtx);
+void MapGenerator::enqueue (std::uint64_t k, Column& c)
+{
+  c.distance = (c.cx - focusX) * (c.cx - focusX) + (c.cy - focusY) * (c.cy - focusY);
+  queue.insert({ c.priority, c.distance, c.order, k });
+}
 
-  auto createTerrainObjects = [this](int h, int i, int j, BiomeType* b)
+std::size_t MapGenerator::refocus (int cx, int cy, const Rect& keep)
+{
+  std::unique_lock lock(generatorMtx);
+  std::size_t cancelled = 0;
+  focusX = cx;
+  focusY = cy;
+  queue.clear();
+  for (auto it = columns.begin(); it != columns.end();)
   {
-    auto it = terrainMap[h].find({i, j});
-    if (it == terrainMap[h].end())
+    auto& c = it->second;
+    if (c.running)
+      ++it;
+    else if (c.priority > 0 && (c.cx < keep.x1 || c.cx > keep.x2 || c.cy < keep.y1 || c.cy > keep.y2))
     {
-      TerrainType* tt;
+      // A request missing a column will never be complete, so its future fails now rather than never
+      for (auto& r : c.waiting)
+        if (!r->cancelled)
+        {
+          r->cancelled = true;
+          r->done.set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+      it = columns.erase(it);
+      cancelled++;
+    }
+    else
+    {
+      enqueue(it->first, c);
+      ++it;
+    }
+  }
+  return cancelled;
+}
+
+void MapGenerator::drain ()
+{
+  std::unique_lock lock(generatorMtx);
+  while (!stopping && queue.size())
+  {
+    auto k = std::get<3>(*queue.begin());
+    queue.erase(queue.begin());
+    auto& c = columns.at(k);
+    c.running = true;
+    auto cx = c.cx;
+    auto cy = c.cy;
+    lock.unlock();
+    owner->generateChunk(cx, cy);
+    lock.lock();
+    auto it = columns.find(k);
+    for (auto& r : it->second.waiting)
+      if (--r->outstanding == 0 && !r->cancelled)
+        r->done.set_value();
+    columns.erase(it);
+  }
+  active--;
+  idle.notify_all();
+}
+
+void MapGenerator::stop ()
+{
+  std::unique_lock lock(generatorMtx);
+  stopping = true;
+  idle.wait(lock, [this]() { return active == 0; });
+  queue.clear();
+  columns.clear();
+  stopping = false;
+}
+
+bool MapController::hasColumn (int cx, int cy)
+{
+  for (auto h = 0; h < maxDepth; h++)
+    if (chunks.contains(h, cx, cy))
+      return true;
+  return false;
+}
+
+// Queues every chunk column overlapping the rect that isn't in memory. Columns already queued or running for an
+// earlier request are shared with it rather than generated twice, and move up to this request's priority if it is
+// more urgent
+std::shared_future<void> MapController::requestChunks(Rect* chunkRect, int priority)
+{
+  std::vector<std::pair<int, int>> wanted;
+  for (auto cx = map::chunk::toChunkCoordinate(chunkRect->x1); cx <= map::chunk::toChunkCoordinate(chunkRect->x2); cx++)
+    for (auto cy = map::chunk::toChunkCoordinate(chunkRect->y1); cy <= map::chunk::toChunkCoordinate(chunkRect->y2); cy++)
+      wanted.push_back({ cx, cy });
+  return mapGenerator.request(this, wanted, priority);
+}
+
+// Called every frame with the camera position: queued columns are taken nearest the camera first, and background
+// requests for columns outside keep, the tiles it is about to see, are dropped before they start
+std::size_t MapController::focusGeneration(int x, int y, Rect* keep)
+{
+  Rect columns {
+    map::chunk::toChunkCoordinate(keep->x1),
+    map::chunk::toChunkCoordinate(keep->y1),
+    map::chunk::toChunkCoordinate(keep->x2),
+    map::chunk::toChunkCoordinate(keep->y2)
+  };
+  auto cancelled = mapGenerator.refocus(map::chunk::toChunkCoordinate(x), map::chunk::toChunkCoordinate(y), columns);
+  if (cancelled)
+    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "Cancelled generating %lu chunk columns out of view", cancelled);
+  return cancelled;
+}
+
+// Generates every chunk column overlapping the rect that isn't in memory, then reapplies its saved changes.
+// Blocks until done, running queued generation on this thread meanwhile.
+int MapController::generateMapChunk(Rect* chunkRect)
+{
+  SDL_Log("Adding terrain, world and mob objects...");
+  auto done = requestChunks(chunkRect);
+  while (done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    if (!executor::shared().runOne())
+      done.wait_for(std::chrono::milliseconds(1));
+  SDL_Log("Done adding objects.");
+
+  auto [terrainCount, objectCount, mobCount] = chunks.countTiles();
+  SDL_Log("Created chunk. Map now has %lu terrain objects, %lu world objects, and %lu mob objects for a total of %lu",
+    terrainCount,
+    objectCount,
+    mobCount,
+    terrainCount+objectCount+mobCount
+  );
+  return 0;
+}
+
+// Generates one column of chunks, every level at (cx, cy), from the world seed alone: per-tile decisions are drawn
+// from keys of the seed, tile and pass, the column's brush strokes from a stream keyed by the seed and column, and
+// generationBounds keeps the passes from seeing or touching neighbours
+void MapController::generateChunk(int cx, int cy)
+{
+  Rect chunkRect {
+    cx << map::chunk::CHUNK_SHIFT,
+    cy << map::chunk::CHUNK_SHIFT,
+    (cx << map::chunk::CHUNK_SHIFT) + map::chunk::CHUNK_MASK,
+    (cy << map::chunk::CHUNK_SHIFT) + map::chunk::CHUNK_MASK
+  };
+  rng::seed(rng::key(worldSeed, 0, cx, cy, rng::COLUMN));
+  generationBounds = &chunkRect;
+  // The passes keep chunk and tile pointers between lookups, so the column mustn't be freed or packed under them
+  chunks.pin(cx, cy);
+
+  auto createTerrainObjects = [this](int h, int i, int j, TypeId b)
+  {
+    if (outsideGeneration(i, j))
+      return;
+    if (findTerrain(h, i, j) == nullptr)
+    {
+      TypeId tt;
+      rng::Stream draw (rng::key(worldSeed, h, i, j, rng::TERRAIN));
       Rect range = { i-1, j-1, i+1, j+1 };
       auto t = generateRangeReport(&range, h);
-      auto [tCount, topTerrainName] = t.topTerrain[h];
-      auto [bCount, topBiomeName] = t.topBiome[h];
-      if (topTerrainName.length() > 0 && cfg->terrainTypes[topTerrainName].clusters == true && cfg->biomeExistsOnLevel(topBiomeName, h))
+      auto [tCount, topTerrain] = t.topTerrain;
+      auto [bCount, topBiome] = t.topBiome;
+      if (topTerrain != NO_TYPE && cfg->getTerrainType(topTerrain)->clusters == true && cfg->biomeExistsOnLevel(topBiome, h))
       {
-        tt = &cfg->terrainTypes[topTerrainName];
-        b = &cfg->biomeTypes[topBiomeName]; 
+        tt = topTerrain;
+        b = topBiome;
       }
       else
-        tt = &cfg->terrainTypes[b->getRandomTerrainTypeName()];
+        tt = cfg->getRandomTerrainTypeId(b, draw.next());
+      if (tt == NO_TYPE)
+        return;
       b = updateTile(h, i, j, b, tt);
-      if ((std::rand() % 10000 > (9500 - ((9500 * tt->getObjectFrequencyMultiplier()) - 9500))) && tt->objectTypeProbabilities.size() > 0)
+      auto terrainType = cfg->getTerrainType(tt);
+      if ((draw.next() % 10000 > (9500 - ((9500 * terrainType->getObjectFrequencyMultiplier()) - 9500))) && !terrainType->objectTypeWeights.empty())
       {
-        std::string n = tt->getRandomObjectTypeName(); // TODO: First check if it's possible, then keep checking until you've got it
-        if (cfg->objectTypes[n].biomes[b->name] && worldMap[h][{i, j}].begin() == worldMap[h][{i, j}].end())
+        auto objectType = cfg->getObjectType(terrainType->getRandomObjectTypeId(draw.next())); // TODO: First check if it's possible, then keep checking until you've got it
+        if (objectType->canExistIn(b) && chunks.getObjects(h, i, j) == objects::NO_HANDLE)
         {
-          std::shared_ptr<WorldObject> o = std::make_shared<WorldObject>(
-            i, j, h, &cfg->objectTypes[n], &cfg->biomeTypes[b->name]
-          );
-          if (cfg->objectTypes[n].isAnimated())
+          auto handle = chunks.worldObjects.create(i, j, h, objectType, b);
+          auto o = chunks.worldObjects.get(handle);
+          if (o == nullptr)
+            return;
+          if (objectType->isAnimated())
           {
             o->animationTimer.start();
-            o->animationSpeed = cfg->objectTypes[n].animationSpeed + std::rand() % 3000;
+            o->animationSpeed = objectType->animationSpeed + draw.next() % 3000;
           }
-          updateTile(h, i, j, o, nullptr);
+          placeObject(h, i, j, handle);
         }  
       }
     }
   };
 
 
-  auto addMobs = [this](int h, int i, int j, BiomeType* b)
+  auto addMobs = [this](int h, int i, int j, TypeId b)
   {
-    auto it = terrainMap[h].find({i, j});
-    if (isPassable({h, i, j}) && it != terrainMap[h].end() && it->second.initialized == false)
+    auto t = findTerrain(h, i, j);
+    if (isPassable({h, i, j}) && t != nullptr && t->initialized == false)
     {
-      if (std::rand() % 1000 > 975)
+      if (rng::at(rng::key(worldSeed, h, i, j, rng::MOB)) % 1000 > 975)
       {
-        
-        for (auto mob = cfg->mobTypes.begin(); mob != cfg->mobTypes.end(); mob++)
+        std::vector<Placement> placements;
+        for (auto mob : cfg->mobTypesById)
         {
-          if (mob->second.biomes.find(it->second.biomeType->name) != mob->second.biomes.end())
+          if (mob->canExistIn(t->biomeId))
           {
-            std::shared_ptr<MobObject> m = std::make_shared<MobObject>(
-              i, j, h, &mob->second, &cfg->biomeTypes[it->second.biomeType->name]
-            );
-
-            if (mob->second.isAnimated())
-            {
-
-              m->simulators.push_back(std::make_shared<simulated::Simulator<MobObject>>(
-                [this,h,i,j,m]()
-                {
-                  
-                  int n = std::rand() % 100;
-                  if (n > 50)
-                    m->x += std::rand() % 100 > 50 ? 1 : -1;
-                  else
-                    m->y += std::rand() % 100 > 50 ? 1 : -1;
-                  if (isPassable({h, i, j}))
-                    m->orders += simulated::MOVE;
-                }
-              ));
-
-              m->animationTimer.start();
-              m->animationSpeed = mob->second.animationSpeed + std::rand() % 3000;
-            }
-
-            updateTile(h, i, j, nullptr, m);
+            auto handle = createMob(h, i, j, mob, t->biomeId);
+            if (handle == objects::NO_HANDLE)
+              continue;
+            placements.push_back({ h, i, j, handle });
           }
         }
+        placeMobs(placements);
       }
     }
-    std::unique_lock lock(mtx);
-    it->second.initialized = true;
+    std::unique_lock lock(chunks.cellLock(h, i, j));
+    if (t != nullptr)
+      t->initialized = true;
   };
 
-  auto hammerChunk = [this](Rect* r, BiomeType* b)
+  auto hammerChunk = [this](Rect* r, TypeId b)
   {
-    auto hammerProcessor = [this](int h, int i, int j)
+    auto hammerProcessor = [this](int h, int i, int j, map::chunk::SlidingReport* t)
     {
-      auto it = terrainMap[h].find({ i, j });
-      if (it != terrainMap[h].end() && it->second.initialized == false)
+      auto it = findTerrain(h, i, j);
+      if (it != nullptr && it->initialized == false)
       {
-        Rect range = { i-3, j-3, i+3, j+3 };
-        auto t = generateRangeReport(&range, h);
-        auto [bCount, topBiomeName] = t.topBiome[h];
-        if (std::rand() % 1000 > 985) topBiomeName = cfg->getRandomBiomeType(h)->name;
-        if (terrainMap[h].find({ i, j })->second.initialized == false) updateTile(h, i, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-        if (terrainMap[h].find({ i+1, j })->second.initialized == false) updateTile(h, i+1, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-        if (terrainMap[h].find({ i-1, j })->second.initialized == false) updateTile(h, i-1, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-        if (terrainMap[h].find({ i, j+1 })->second.initialized == false) updateTile(h, i, j+1, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-        if (terrainMap[h].find({ i, j-1 })->second.initialized == false) updateTile(h, i, j-1, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
+        auto [bCount, topBiome] = t->topBiome;
+        rng::Stream draw (rng::key(worldSeed, h, i, j, rng::HAMMER));
+        if (draw.next() % 1000 > 985) topBiome = cfg->getRandomBiomeTypeId(h, draw.next());
+        auto uninitialized = [this, h](int x, int y) { auto n = findTerrain(h, x, y); return n != nullptr && n->initialized == false; };
+        thread_local std::vector<TileEdit> edits;
+        edits.clear();
+        const std::pair<int, int> tiles[] = { { i, j }, { i+1, j }, { i-1, j }, { i, j+1 }, { i, j-1 } };
+        for (auto [x, y] : tiles)
+          if (uninitialized(x, y))
+            if (auto tt = cfg->getRandomTerrainTypeId(topBiome, draw.next()); tt != NO_TYPE)
+              edits.push_back({ h, x, y, topBiome, tt });
+        updateTiles(t, edits);
       }
     };
-    processChunk(r, hammerProcessor);
+    processChunkWithReport(r, 3, hammerProcessor);
   };
 
-  auto cleanChunk = [this](Rect* r, BiomeType* b)
+  auto cleanChunk = [this](Rect* r, TypeId b)
   {
-    auto processor = [this](int h, int i, int j)
+    auto processor = [this](int h, int i, int j, map::chunk::SlidingReport* t)
     {
-      auto it = terrainMap[h].find({ i, j });
-      if (it != terrainMap[h].end() && it->second.initialized == false)
+      auto it = findTerrain(h, i, j);
+      if (it != nullptr && it->initialized == false)
       {
-        Rect range = { i-3, j-3, i+3, j+3 };
-        auto t = generateRangeReport(&range, h);
-        auto [bCount, topBiomeName] = t.topBiome[h];
-        if (t.biomeCounts[h][it->second.biomeType->name] <= 2) updateTile(h, i, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
+        auto [bCount, topBiome] = t->topBiome;
+        if (t->biomeCounts[it->biomeId] <= 2)
+          if (auto tt = cfg->getRandomTerrainTypeId(topBiome, rng::at(rng::key(worldSeed, h, i, j, rng::CLEAN))); tt != NO_TYPE)
+            updateTile(t, h, i, j, topBiome, tt);
       }
     };
-    processChunk(r, processor);
+    processChunkWithReport(r, 3, processor);
   };
 
-  auto fudgeChunk = [this](Rect* r, BiomeType* b)
+  // Fudging runs twice, so each run is made for its own pass
+  auto fudgeChunk = [this](rng::pass p) -> map::chunk::chunkProcessorCallbackFunctor { return [this, p](Rect* r, TypeId b)
   {
-    auto fudgeProcessor = [this](int h, int i, int j)
+    auto fudgeProcessor = [this, p](int h, int i, int j, map::chunk::SlidingReport* t)
     {
-      auto it = terrainMap[h].find({ i, j });
-      if (it == terrainMap[h].end())
+      auto it = findTerrain(h, i, j);
+      if (it == nullptr)
       {
         //make tile based on most common biome in range of 1
       }
-      else if (it->second.initialized == false)
+      else if (it->initialized == false)
       {
-        Rect range = { i-2, j-2, i+2, j+2 };
-        auto t = generateRangeReport(&range, h);
-        auto [bCount, topBiomeName] = t.topBiome[h];
-        if (it->second.biomeType->name != topBiomeName && cfg->biomeExistsOnLevel(topBiomeName, h))
+        auto [bCount, topBiome] = t->topBiome;
+        if (it->biomeId != topBiome && cfg->biomeExistsOnLevel(topBiome, h))
         {
-            if (std::rand() % 10 > 4)
+            rng::Stream draw (rng::key(worldSeed, h, i, j, p));
+            if (draw.next() % 10 > 4)
             {
-              updateTile(h, i, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
+              if (auto tt = cfg->getRandomTerrainTypeId(topBiome, draw.next()); tt != NO_TYPE)
+                updateTile(t, h, i, j, topBiome, tt);
             }
             else
             {
-              updateTile(h, i+1, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-              updateTile(h, i-1, j, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-              updateTile(h, i, j+1, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
-              updateTile(h, i, j-1, &cfg->biomeTypes[topBiomeName], cfg->getRandomTerrainType(topBiomeName) );
+              thread_local std::vector<TileEdit> edits;
+              edits.clear();
+              const std::pair<int, int> tiles[] = { { i+1, j }, { i-1, j }, { i, j+1 }, { i, j-1 } };
+              for (auto [x, y] : tiles)
+                if (auto tt = cfg->getRandomTerrainTypeId(topBiome, draw.next()); tt != NO_TYPE)
+                  edits.push_back({ h, x, y, topBiome, tt });
+              updateTiles(t, edits);
             }
         }
       }
     };
-    if (std::rand() % 100 > 65) processChunk(r, fudgeProcessor);
-  };
+    if (rng::at(rng::key(worldSeed, 0, r->x1, r->y1, p)) % 100 > 65) processChunkWithReport(r, 2, fudgeProcessor);
+  }; };
 
   map::chunk::multiprocessFunctorVec terrainPlacement { { createTerrainObjects, [this](map::chunk::ChunkProcessor* p, int z, std::tuple<int, int> coords)
   {
-    if (cfg->biomeExistsOnLevel(p->getBrush()->name, z) == false)
-      p->setBrush(cfg->getRandomBiomeType(z)); 
-    if (std::rand() % 10 > 5)
+    auto [i, j] = coords;
+    rng::Stream draw (rng::key(worldSeed, z, i, j, rng::BRUSH));
+    if (cfg->biomeExistsOnLevel(p->getBrush(), z) == false)
+      p->setBrush(cfg->getRandomBiomeTypeId(z, draw.next()));
+    if (draw.next() % 10 > 5)
     {
-      auto [i, j] = coords;
       Rect range = { i-5, j-5, i+5, j+5 };
-      auto t = generateRangeReport(&range, 0);
-      auto [bCount, topBiomeName] = t.topBiome[z];
-      if (topBiomeName.length() > 0 && cfg->biomeExistsOnLevel(topBiomeName, z) == true)
-        p->setBrush(&cfg->biomeTypes[topBiomeName]);
+      auto t = generateRangeReport(&range, z);
+      auto [bCount, topBiome] = t.topBiome;
+      if (topBiome != NO_TYPE && cfg->biomeExistsOnLevel(topBiome, z) == true)
+        p->setBrush(topBiome);
       else
-        p->setBrush(cfg->getRandomBiomeType(z));
+        p->setBrush(cfg->getRandomBiomeTypeId(z, draw.next()));
     }
     return p->getBrush(); } }
 
   };
+  // The post-processing passes ignore the biome they are handed, but it is still drawn from the tile it is for
+  auto biomeAt = [this](rng::pass p) -> map::chunk::chunkCallbackFn
+  {
+    return [this, p](map::chunk::ChunkProcessor*, int z, std::tuple<int, int> coords)
+    {
+      auto [i, j] = coords;
+      return cfg->getRandomBiomeTypeId(z, rng::at(rng::key(worldSeed, z, i, j, p)));
+    };
+  };
   map::chunk::multiprocessFunctorVec chunkFudging {
-    { fudgeChunk, [this](map::chunk::ChunkProcessor* p,int z,std::tuple<int,int>coords){return cfg->getRandomBiomeType(z);} },
-    { hammerChunk, [this](map::chunk::ChunkProcessor* p,int z,std::tuple<int,int>coords){return cfg->getRandomBiomeType(z);} },
-    { fudgeChunk, [this](map::chunk::ChunkProcessor* p,int z,std::tuple<int,int>coords){return cfg->getRandomBiomeType(z);} },
-    { cleanChunk, [this](map::chunk::ChunkProcessor* p,int z,std::tuple<int,int>coords){return cfg->getRandomBiomeType(z);} }
+    { fudgeChunk(rng::FUDGE), biomeAt(rng::FUDGE) },
+    { hammerChunk, biomeAt(rng::HAMMER) },
+    { fudgeChunk(rng::REFUDGE), biomeAt(rng::REFUDGE) },
+    { cleanChunk, biomeAt(rng::CLEAN) }
   };
-  map::chunk::multiprocessFunctorVec objectPlacement { { addMobs, [this](map::chunk::ChunkProcessor* p,int z,std::tuple<int,int>coords){return cfg->getRandomBiomeType(); } } };
+  map::chunk::multiprocessFunctorVec objectPlacement { { addMobs, biomeAt(rng::MOB) } };
 
-  map::chunk::ChunkProcessor chunker ( chunkRect, maxDepth );
-  chunker.setBrush(cfg->getRandomBiomeType(0));
-  SDL_Log("Adding terrain objects...");
+  // Brush strokes of about five tiles, as when the initial map was split 25 ways
+  map::chunk::ChunkProcessor chunker ( &chunkRect, maxDepth, map::chunk::CHUNK_SIZE / 5 );
+  chunker.setBrush(cfg->getRandomBiomeTypeId(0, rng::at(rng::key(worldSeed, 0, cx, cy, rng::BRUSH))));
+  SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "Generating chunk (%d, %d)", cx, cy);
   // std::thread t([this, &chunker](multiprocessChain o, multiprocessChain c){ chunker.multiProcessChunk({ o, c }); }, objectPlacers, chunkFuzzers);
   // t.join();
   chunker.multiProcessChunk({ terrainPlacement, chunkFudging });
-  SDL_Log("Adding world and mob objects...");
   
   // TODO: Chunkfuzz is fine but not in this case because this is what initializes all tiles. Need something else for that
   chunker.multiProcessChunk({ objectPlacement });
-  SDL_Log("Done adding objects.");
+  generationBounds = nullptr;
 
-  mapGenerator.reset(&mtx);
-  std::unique_lock lock(mtx);
-  SDL_Log("Created chunk. Map now has %lu terrain objects, %lu world objects, and %lu mob objects for a total of %lu",
-    terrainMap[0].size()*2,
-    worldMap[0].size()*2,
-    terrainMap[0].size()*2,
-    terrainMap[0].size()*2+worldMap[0].size()*2+mobMap[0].size()*2
-  );
-  return 0;
+  // Generation itself isn't a change worth saving, but the finished column is one worth showing
+  for (auto h = 0; h < maxDepth; h++)
+  {
+    if (auto c = chunks.find(h, chunkRect.x1, chunkRect.y1))
+      c->dirty = false;
+    regions.read(h, cx, cy, [this, h, cx, cy](const std::uint8_t* p, std::size_t n) { return applyDelta(h, cx, cy, p, n); });
+    std::unique_lock lock(chunks.cellLock(h, chunkRect.x1, chunkRect.y1));
+    if (auto c = chunks.find(h, chunkRect.x1, chunkRect.y1))
+    {
+      c->unpublished = true;
+      chunks.handOff(c);
+    }
+  }
+  chunks.unpin(cx, cy);
 }
 
 #endif
\ No newline at end of file
@@ -5,38 +5,71 @@
 
 using namespace map;
 
-std::shared_mutex mobMtx;
+// Creates a mob with its wandering simulator; placing it on the map is left to the caller
+objects::Handle MapController::createMob (int h, int i, int j, MobType* mob, TypeId b)
+{
+  auto handle = chunks.mobObjects.create(i, j, h, mob, b);
+  auto m = chunks.mobObjects.get(handle);
+  if (m == nullptr)
+    return objects::NO_HANDLE;
+
+  if (mob->isAnimated())
+  {
+
+    m->simulators.push_back(simulated::Simulator<MobObject>(
+      [this,h,i,j,handle]()
+      {
+        auto m = chunks.mobObjects.get(handle);
+        if (m == nullptr)
+          return;
+        int n = rng::next() % 100;
+        if (n > 50)
+          m->x += rng::next() % 100 > 50 ? 1 : -1;
+        else
+          m->y += rng::next() % 100 > 50 ? 1 : -1;
+        if (isPassable({h, i, j}, false))
+          m->orders += simulated::MOVE;
+      }
+    ));
+
+    m->animationTimer.start();
+    m->animationSpeed = mob->animationSpeed + rng::next() % 3000;
+  }
+  return handle;
+}
 
-std::vector<std::shared_ptr<MobObject>>::iterator
-MapController::moveMob (std::string id, std::tuple<int, int, int> origin, std::tuple<int, int, int> destination)
+bool MapController::moveMob (objects::Handle m, std::tuple<int, int, int> origin, std::tuple<int, int, int> destination)
 {
   auto [z1, x1, y1] = origin;
   auto [z2, x2, y2] = destination;
-  if (!isPassable(destination))
-    return mobMap[z1][{x1, y1}].begin();
-  std::unique_lock lock(mobMtx);
-  auto it = mobMap[z1][{x1, y1}].begin();
-  while (it != mobMap[z1][{x1, y1}].end())
-  {
-    if (it->get()->id == id)
-    {
-      it->get()->setPosition({ z2, x2, y2 });
-      mobMap[z2][{x2, y2}].push_back((*it));
-      it = mobMap[z1][{x1, y1}].erase(it);
-      return it;
-    }
-    else
-    {
-      ++it;
-    }
-  }
-  return it;
+  // Mobs move on the render thread, which never waits on disk; a mob can't step into an evicted chunk
+  if (!isPassable(destination, false))
+    return false;
+  auto locks = chunks.lockCells(z1, x1, y1, z2, x2, y2);
+  auto mob = chunks.mobObjects.get(m);
+  auto from = chunks.findOrCreate(z1, x1, y1);
+  int i = map::chunk::toLocalIndex(x1, y1);
+  if (mob == nullptr || !chunks.mobObjects.unlink(from->mobs[i], m))
+    return false;
+  from->journal.record(i, map::chunk::MOB_LAYER, map::chunk::CHANGE_REMOVE);
+  from->delta.mobs = true;
+  updatePassability(from, i);
+  mob->setPosition({ z2, x2, y2 });
+  auto to = chunks.findOrCreate(z2, x2, y2);
+  int j = map::chunk::toLocalIndex(x2, y2);
+  chunks.mobObjects.push(to->mobs[j], m);
+  to->journal.record(j, map::chunk::MOB_LAYER, map::chunk::CHANGE_ADD);
+  to->delta.mobs = true;
+  updatePassability(to, j);
+  chunks.handOff(from, to);
+  return true;
 }
 
-std::vector<std::shared_ptr<MobObject>>::iterator
-MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt, std::tuple<int, int, int> coords, int directions)
+void MapController::moveMob (objects::Handle m, std::tuple<int, int, int> coords, int directions)
 {
-  auto mob = mobIt->get();
+  auto mob = chunks.mobObjects.get(m);
+  if (mob == nullptr)
+    return;
   auto [z1, x1, y1] = coords;
   auto [z2, x2, y2] = coords;
   if (directions & tileObject::LEFT)
@@ -48,7 +81,7 @@ MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt,
     else
     {
       mob->direction = tileObject::LEFT;
-      return ++mobIt;
+      return;
     }
   }
   if (directions & tileObject::RIGHT)
@@ -60,7 +93,7 @@ MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt,
     else
     {
       mob->direction = tileObject::RIGHT;
-      return ++mobIt;
+      return;
     }
   }
   if (directions & tileObject::UP)
@@ -72,7 +105,7 @@ MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt,
     else
     {
       mob->direction = tileObject::UP;
-      return ++mobIt;
+      return;
     }
   }
   if (directions & tileObject::DOWN)
@@ -84,7 +117,7 @@ MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt,
     else
     {
       mob->direction = tileObject::DOWN;
-      return ++mobIt;
+      return;
     }
   }
   SDL_Point offset = {0, 0};
@@ -98,7 +131,7 @@ MapController::moveMob (std::vector<std::shared_ptr<MobObject>>::iterator mobIt,
     offset.x += cfg->tileSize;
   mob->relativeX = offset.x;
   mob->relativeY = offset.y;
-  return moveMob(mob->id, {z1, x1, y1}, {z2, x2, y2});
+  moveMob(m, {z1, x1, y1}, {z2, x2, y2});
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#ifndef GAME_MAP_PERSISTENCE_H
+#define GAME_MAP_PERSISTENCE_H
+
+#include "map.h"
+
+using namespace map;
+
+namespace map
+{
+  // A world object or mob in a saved delta; speed only applies to mobs
+  struct SavedObject
+  {
+    std::uint16_t index;
+    TypeId typeId;
+    TypeId biomeId;
+    std::uint16_t direction;
+    std::int32_t speed;
+    std::int32_t animationSpeed;
+  };
+  const int BITSET_WORDS = map::chunk::CHUNK_AREA / 64;
+}
+
+// A delta is the chunk's edited cells, each its biome id, terrain id and initialized flag as one byte, followed by
+// its object and mob lists when those changed. Type ids follow the order of the configuration file, and deltas
+// saved under a different one are discarded.
+std::vector<std::uint8_t> MapController::encodeDelta (const map::chunk::Chunk& c)
+{
+  map::chunk::PayloadWriter out;
+  out.put(static_cast<std::int32_t>(c.z));
+  out.put(static_cast<std::int32_t>(c.cx));
+  out.put(static_cast<std::int32_t>(c.cy));
+  out.put(static_cast<std::uint8_t>(c.delta.objects | c.delta.mobs << 1));
+  std::array<std::uint64_t, BITSET_WORDS> edited {};
+  for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+    edited[i >> 6] |= static_cast<std::uint64_t>(c.delta.edited[i]) << (i & 63);
+  out.put(edited);
+  for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+    if (c.delta.edited[i])
+    {
+      out.put(c.terrain[i].biomeId);
+      out.put(c.terrain[i].terrainId);
+      out.put(static_cast<std::uint8_t>(c.terrain[i].initialized));
+    }
+  std::vector<SavedObject> objects, mobs;
+  for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+  {
+    std::uint16_t index = i;
+    if (c.delta.objects)
+      chunks.worldObjects.forEach(c.objects[i], [&objects, index](objects::Handle h, WorldObject* o) {
+        objects.push_back({ index, o->objectType->id, o->biomeId, 0, 0, o->objectType->isAnimated() ? o->animationSpeed : 0 });
+      });
+    if (c.delta.mobs)
+      chunks.mobObjects.forEach(c.mobs[i], [&mobs, index](objects::Handle h, MobObject* m) {
+        mobs.push_back({ index, m->mobType->id, m->biomeId, static_cast<std::uint16_t>(m->direction), m->speed,
+          m->mobType->isAnimated() ? m->animationSpeed : 0 });
+      });
+  }
+  if (c.delta.objects)
+  {
+    out.put(static_cast<std::uint32_t>(objects.size()));
+    out.put(objects.data(), objects.size() * sizeof(SavedObject));
+  }
+  if (c.delta.mobs)
+  {
+    out.put(static_cast<std::uint32_t>(mobs.size()));
+    out.put(mobs.data(), mobs.size() * sizeof(SavedObject));
+  }
+  return std::move(out.bytes);
+}
+
+// Reapplies a saved delta to a freshly generated chunk
+bool MapController::applyDelta (int z, int cx, int cy, const std::uint8_t* data, std::size_t length)
+{
+  map::chunk::PayloadReader in { data, data + length };
+  std::int32_t savedZ, savedX, savedY;
+  std::uint8_t flags;
+  std::array<std::uint64_t, BITSET_WORDS> edited;
+  std::vector<std::pair<int, TerrainObject>> cells;
+  std::vector<SavedObject> objects, mobs;
+  auto getObjects = [&in, length](std::vector<SavedObject>& v) {
+    std::uint32_t n;
+    if (!in.get(n) || n > length / sizeof(SavedObject))
+      return false;
+    v.resize(n);
+    return in.get(v.data(), n * sizeof(SavedObject));
+  };
+  bool valid = in.get(savedZ) && in.get(savedX) && in.get(savedY) && savedZ == z && savedX == cx && savedY == cy
+    && in.get(flags) && in.get(edited);
+  for (auto i = 0; valid && i < map::chunk::CHUNK_AREA; i++)
+  {
+    TerrainObject t;
+    std::uint8_t initialized;
+    if ((edited[i >> 6] >> (i & 63) & 1) == 0)
+      continue;
+    valid = in.get(t.biomeId) && in.get(t.terrainId) && in.get(initialized) && initialized <= 1
+      && t.terrainId < cfg->terrainTypesById.size() && t.biomeId < cfg->biomeTypesById.size();
+    t.initialized = initialized;
+    cells.push_back({ i, t });
+  }
+  valid = valid && ((flags & 1) == 0 || getObjects(objects)) && ((flags & 2) == 0 || getObjects(mobs));
+  for (auto& o : objects)
+    valid = valid && o.index < map::chunk::CHUNK_AREA && o.typeId < cfg->objectTypesById.size()
+      && o.biomeId < cfg->biomeTypesById.size();
+  for (auto& m : mobs)
+    valid = valid && m.index < map::chunk::CHUNK_AREA && m.typeId < cfg->mobTypesById.size()
+      && m.biomeId < cfg->biomeTypesById.size();
+  if (!valid)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Saved changes to chunk %d,%d on level %d don't match this configuration; discarding them", cx, cy, z);
+    return false;
+  }
+
+  std::unique_lock lock(chunks.cellLock(z, cx << map::chunk::CHUNK_SHIFT, cy << map::chunk::CHUNK_SHIFT));
+  auto c = chunks.findOrCreate(z, cx << map::chunk::CHUNK_SHIFT, cy << map::chunk::CHUNK_SHIFT);
+  for (auto& [i, t] : cells)
+  {
+    c->setTerrain(i, t);
+    c->delta.edited[i] = true;
+    c->journal.record(i, map::chunk::TERRAIN_LAYER, map::chunk::CHANGE_SET);
+  }
+  // Lists are saved head first, so pushing in reverse restores their order
+  auto x = [cx](int index) { return (cx << map::chunk::CHUNK_SHIFT) + (index & map::chunk::CHUNK_MASK); };
+  auto y = [cy](int index) { return (cy << map::chunk::CHUNK_SHIFT) + (index >> map::chunk::CHUNK_SHIFT); };
+  if (flags & 1)
+  {
+    for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+      if (c->objects[i] != objects::NO_HANDLE)
+      {
+        chunks.worldObjects.clear(c->objects[i]);
+        c->journal.record(i, map::chunk::OBJECT_LAYER, map::chunk::CHANGE_REMOVE);
+      }
+    for (auto it = objects.rbegin(); it != objects.rend(); it++)
+    {
+      auto objectType = cfg->getObjectType(it->typeId);
+      auto handle = chunks.worldObjects.create(x(it->index), y(it->index), z, objectType, it->biomeId);
+      auto o = chunks.worldObjects.get(handle);
+      if (o == nullptr)
+        continue;
+      if (objectType->isAnimated())
+      {
+        o->animationTimer.start();
+        o->animationSpeed = it->animationSpeed;
+      }
+      chunks.worldObjects.push(c->objects[it->index], handle);
+      c->journal.record(it->index, map::chunk::OBJECT_LAYER, map::chunk::CHANGE_ADD);
+    }
+    c->delta.objects = true;
+  }
+  if (flags & 2)
+  {
+    for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+      if (c->mobs[i] != objects::NO_HANDLE)
+      {
+        chunks.mobObjects.clear(c->mobs[i]);
+        c->journal.record(i, map::chunk::MOB_LAYER, map::chunk::CHANGE_REMOVE);
+      }
+    for (auto it = mobs.rbegin(); it != mobs.rend(); it++)
+    {
+      auto mobType = cfg->getMobType(it->typeId);
+      auto handle = createMob(z, x(it->index), y(it->index), mobType, it->biomeId);
+      auto m = chunks.mobObjects.get(handle);
+      if (m == nullptr)
+        continue;
+      m->speed = it->speed;
+      m->direction = it->direction;
+      if (mobType->isAnimated())
+        m->animationSpeed = it->animationSpeed;
+      chunks.mobObjects.push(c->mobs[it->index], handle);
+      c->journal.record(it->index, map::chunk::MOB_LAYER, map::chunk::CHANGE_ADD);
+    }
+    c->delta.mobs = true;
+  }
+  for (auto i = 0; i < map::chunk::CHUNK_AREA; i++)
+    updatePassability(c, i);
+  c->dirty = false;
+  chunks.handOff(c);
+  return true;
+}
+
+// Called on the way out. Queued generation is dropped and running columns finish first, since they reapply saved
+// deltas to the chunks being saved.
+std::size_t MapController::saveWorld ()
+{
+  if (regions.path.empty())
+    return 0;
+  mapGenerator.stop();
+  std::vector<map::chunk::RegionStore::Payload> payloads;
+  chunks.forEachDirty([this, &payloads](const map::chunk::Chunk& c) {
+    if (!c.delta.empty())
+      payloads.push_back({ c.z, c.cx, c.cy, encodeDelta(c) });
+  });
+  auto changed = payloads.size();
+  auto written = regions.write(std::move(payloads));
+  SDL_Log("Saved %lu of %lu changed chunks to %s", written, changed, regions.path.c_str());
+  return written;
+}
+
+#endif
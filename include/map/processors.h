@@ -11,13 +11,40 @@ void MapController::processChunk(Rect* chunkRect, std::function<void(int, int, i
     "Processing chunk: on %d levels from ( %d, %d ) to ( %d, %d )",
     maxDepth, chunkRect->x1, chunkRect->y1, chunkRect->x2, chunkRect->y2
   );
-  int n = std::rand() % 10;
+  int n = rng::next() % 10;
   for (auto h = 0; h < maxDepth; h++)
     for (auto i = n > 5 ? chunkRect->x1 : chunkRect->x2; [i,chunkRect,n](){if(n>5)return i<=chunkRect->x2;else return i>=chunkRect->x1;}() ; [&i,n](){if(n>5)i+=1;else i-=1;}())
       for (auto j = n > 5 ? chunkRect->y1 : chunkRect->y2; [j,chunkRect,n](){if(n>5)return j<=chunkRect->y2;else return j>=chunkRect->y1;}() ; [&j,n](){if(n>5)j+=1;else j-=1;}())
         f(h, i ,j);
 }
 
+// Like processChunk, but walks each level in a serpentine so every step moves one tile and f can be handed
+// a report of the window around the tile that is only slid, never rebuilt
+template <typename F>
+void MapController::processChunkWithReport(Rect* chunkRect, int radius, F f)
+{
+  SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+    "Processing chunk with reports: on %d levels from ( %d, %d ) to ( %d, %d )",
+    maxDepth, chunkRect->x1, chunkRect->y1, chunkRect->x2, chunkRect->y2
+  );
+  int n = rng::next() % 10;
+  int di = n > 5 ? 1 : -1;
+  for (auto h = 0; h < maxDepth; h++)
+  {
+    map::chunk::SlidingReport report (h, radius);
+    int dj = di;
+    for (auto i = di > 0 ? chunkRect->x1 : chunkRect->x2; i >= chunkRect->x1 && i <= chunkRect->x2; i += di)
+    {
+      for (auto j = dj > 0 ? chunkRect->y1 : chunkRect->y2; j >= chunkRect->y1 && j <= chunkRect->y2; j += dj)
+      {
+        moveRangeReport(&report, i, j);
+        f(h, i, j, &report);
+      }
+      dj = -dj;
+    }
+  }
+}
+
 template <typename F>
 void MapController::iterateOverChunk(Rect* chunkRect, F functors)
 {
@@ -29,23 +56,22 @@ void MapController::iterateOverChunk(Rect* chunkRect, F functors)
   Rect r { chunkRect->x1, chunkRect->y1, chunkRect->x2, chunkRect->y2 };
   auto rects = r.getRects();
   SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "Analyzing chunk: (x1: %d, y1: %d) (x2: %d, y2: %d) [%d]", chunkRect->x1, chunkRect->y1, chunkRect->x2, chunkRect->y2, static_cast<int>(rects->size()));
-  auto it = rects->begin();
-  while (it != rects->end())
+  executor::TaskGroup group;
+  for (auto it = rects->begin(); it != rects->end(); ++it)
   {
-    std::thread t([this, functors](int x1, int y1, int x2, int y2) {
+    group.spawn([this, functors, x1 = it->x1, y1 = it->y1, x2 = it->x2, y2 = it->y2]() {
       for (auto h = 0; h < maxDepth; h++)
       {
-        BiomeType* b = cfg->getRandomBiomeType(h);
+        TypeId b = cfg->getRandomBiomeTypeId(h);
         for (auto i = x1; i != x2; i++)
           for (auto j = y1; j != y2; j++)
             for (auto f : functors)
               f(h, i, j, b);
       }
-    }, it->x1, it->y1, it->x2, it->y2);
-    t.detach();
+    });
     SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "\t- (x1: %d, y1: %d) (x2: %d, y2: %d)", it->x1, it->x2, it->y1, it->y2);
-    ++it;
   }
+  group.wait();
 }
 
 template <typename F>
@@ -56,16 +82,15 @@ void MapController::iterateOverChunkEdges(Rect* chunk, F f)
   Rect left { chunk->x1, chunk->y1, chunk->x1, chunk->y2 };
   Rect right { chunk->x2, chunk->y1, chunk->x2, chunk->y2 };
   std::vector<Rect> edges { top, bottom, left, right };
+  executor::TaskGroup group;
   for (auto it = edges.begin(); it != edges.end(); ++it)
-  {
-    std::thread t([this, f](int x1, int y1, int x2, int y2) {
+    group.spawn([this, f, x1 = it->x1, y1 = it->y1, x2 = it->x2, y2 = it->y2]() {
       for (auto h = 0; h < maxDepth; h++)
         for (auto i = x1; i <= x2; i++)
           for (auto j = y1; j <= y2; j++)
             f(h, i, j);
-    }, it->x1, it->y1, it->x2, it->y2);
-    t.detach();
-  }
+    });
+  group.wait();
 }
 
 void MapController::randomlyAccessAllTilesInChunk(Rect* chunkRect, std::function<void(int, int, int)> f)
@@ -79,7 +104,7 @@ void MapController::randomlyAccessAllTilesInChunk(Rect* chunkRect, std::function
   {
     while (coordinates[h].size())
     {
-      int i = std::rand() % coordinates[h].size();
+      int i = rng::next() % coordinates[h].size();
       SDL_Point p = coordinates[h].at(i);
       f(h, p.x, p.y);
       coordinates[h].erase(coordinates[h].begin() + i);
@@ -5,78 +5,209 @@
 
 using namespace map;
 
-std::shared_mutex tileMutex;
-
-BiomeType* MapController::updateTile (int z, int x, int y, BiomeType* biomeType, TerrainType* terrainType, objects::objectsVector worldObjects = objects::objectsVector ())
+// Sorts items by chunk and calls f(chunk, item) on each, taking each chunk's cell lock once for all of its
+// items. Items keep their order within a chunk, so a later edit to the same tile still wins.
+template <typename T, typename F>
+void MapController::forEachByChunk (std::vector<T>& items, F f)
 {
-  if (!cfg->biomeExistsOnLevel(biomeType->name, z))
+  // Generation passes batch a handful of tiles at a time, so the scratch space is kept rather than reallocated
+  thread_local std::vector<std::pair<std::uint64_t, std::size_t>> order;
+  order.clear();
+  for (std::size_t n = 0; n < items.size(); n++)
   {
-    biomeType = cfg->getRandomBiomeType(z);
-    terrainType = &cfg->terrainTypes[biomeType->getRandomTerrainTypeName()];
+    auto& t = items[n];
+    order.push_back({ map::chunk::ChunkStore::key(t.z, map::chunk::toChunkCoordinate(t.x), map::chunk::toChunkCoordinate(t.y)), n });
   }
-  std::unique_lock lock(tileMutex);
-  TerrainObject t;
-  t.x = x;
-  t.y = y;
-  t.biomeType = biomeType;
-  t.terrainType = terrainType;
-  if (terrainType->isAnimated())
+  if (!std::is_sorted(order.begin(), order.end()))
+    std::sort(order.begin(), order.end());
+  for (std::size_t n = 0; n < order.size(); )
   {
-    t.animationTimer.start();
-    t.animationSpeed = terrainType->animationSpeed + std::rand() % 3000;
+    auto k = order[n].first;
+    auto& first = items[order[n].second];
+    std::unique_lock lock(chunks.cellLocks[map::chunk::ChunkStore::stripe(k)]);
+    auto chunk = chunks.findOrCreate(first.z, first.x, first.y);
+    for (; n < order.size() && order[n].first == k; n++)
+      f(chunk, items[order[n].second]);
+    chunks.handOff(chunk);
   }
-  terrainMap[z][{ x, y }] = t;
-
-
-  for (auto o : worldMap[z][{ x, y }])
-    if (!o->objectType->biomes[biomeType->name])
-    {
-      worldMap[z][{ x, y }].clear();
-      break;
-    }
-  
-  
-  mobMap[z][{ x, y }].clear();
-  BiomeObject b;
-  b.biomeType = biomeType;
-  b.x = x;
-  b.y = y;
-  biomeMap[z][{ x, y }] = b;
-  return biomeType;
 }
 
-void MapController::updateTile (int z, int x, int y, std::shared_ptr<WorldObject> w = nullptr, std::shared_ptr<MobObject> m = nullptr)
+// Falls back to a random biome of the level, as updateTile always has, when the edit's doesn't exist there
+void MapController::resolveTileEdit (TileEdit& e)
 {
-  std::unique_lock lock(tileMutex);
-  if (w != nullptr)
+  if (!cfg->biomeExistsOnLevel(e.biomeId, e.z))
   {
-    worldMap[z][{x, y}].push_back(w);
+    e.biomeId = cfg->getRandomBiomeTypeId(e.z);
+    e.terrainId = cfg->getRandomTerrainTypeId(e.biomeId);
   }
-  if (m != nullptr)
+}
+
+TypeId MapController::updateTile (int z, int x, int y, TypeId biomeType, TypeId terrainType)
+{
+  if (outsideGeneration(x, y))
+    return biomeType;
+  TileEdit e { z, x, y, biomeType, terrainType };
+  resolveTileEdit(e);
+  if (e.terrainId == NO_TYPE)
+    return biomeType;
+  std::unique_lock lock(chunks.cellLock(z, x, y));
+  auto chunk = chunks.findOrCreate(z, x, y);
+  setTile(chunk, map::chunk::toLocalIndex(x, y), e.biomeId, e.terrainId);
+  chunks.handOff(chunk);
+  return e.biomeId;
+}
+
+// Applies edits a chunk at a time; edits outside the chunk being generated are dropped. Each edit is left
+// holding the biome it was given. Returns the number applied.
+std::size_t MapController::updateTiles (std::vector<TileEdit>& edits)
+{
+  edits.erase(std::remove_if(edits.begin(), edits.end(), [this](const TileEdit& e) { return outsideGeneration(e.x, e.y); }), edits.end());
+  for (auto& e : edits)
+    resolveTileEdit(e);
+  edits.erase(std::remove_if(edits.begin(), edits.end(), [](const TileEdit& e) { return e.terrainId == NO_TYPE; }), edits.end());
+  forEachByChunk(edits, [this](map::chunk::Chunk* chunk, TileEdit& e) {
+    setTile(chunk, map::chunk::toLocalIndex(e.x, e.y), e.biomeId, e.terrainId);
+  });
+  return edits.size();
+}
+
+// Fills every tile of the rect, edges included, on level z
+std::size_t MapController::updateTiles (int z, Rect* r, TypeId biomeType, TypeId terrainType)
+{
+  std::vector<TileEdit> edits;
+  edits.reserve(static_cast<std::size_t>(r->x2 - r->x1 + 1) * (r->y2 - r->y1 + 1));
+  for (auto x = r->x1; x <= r->x2; x++)
+    for (auto y = r->y1; y <= r->y2; y++)
+      edits.push_back({ z, x, y, biomeType, terrainType });
+  return updateTiles(edits);
+}
+
+// Like updateTiles, keeping a sliding report that covers some of the tiles in step; edits must name distinct tiles
+std::size_t MapController::updateTiles (map::chunk::SlidingReport* r, std::vector<TileEdit>& edits)
+{
+  auto count = [this, r, &edits](bool remove) {
+    map::chunk::ChunkStore::CellReader cells (chunks);
+    for (auto& e : edits)
+      if (r->contains(e.z, e.x, e.y) && !outsideGeneration(e.x, e.y))
+        countTileInReport(cells, r, e.x, e.y, remove);
+  };
+  count(true);
+  auto n = updateTiles(edits);
+  count(false);
+  r->rerank(cfg->terrainTypesById.size(), cfg->biomeTypesById.size());
+  return n;
+}
+
+// Rewrites one cell of a chunk whose cell lock the caller holds exclusively
+void MapController::setTile (map::chunk::Chunk* chunk, int i, TypeId biomeType, TypeId terrainType)
+{
+  chunk->setTerrain(i, TerrainObject(biomeType, terrainType));
+
+  bool keepObjects = true;
+  chunks.worldObjects.forEach(chunk->objects[i], [&keepObjects, biomeType](objects::Handle h, WorldObject* o) {
+    keepObjects = keepObjects && o->objectType->canExistIn(biomeType);
+  });
+  if (!generating())
   {
-    mobMap[z][{x, y}].push_back(std::move(m));
+    chunk->delta.edited[i] = true;
+    chunk->delta.objects = chunk->delta.objects || keepObjects == false;
+    chunk->delta.mobs = chunk->delta.mobs || chunk->mobs[i] != objects::NO_HANDLE;
   }
+  chunk->journal.record(i, map::chunk::TERRAIN_LAYER, map::chunk::CHANGE_SET);
+  if (keepObjects == false && chunk->objects[i] != objects::NO_HANDLE)
+    chunk->journal.record(i, map::chunk::OBJECT_LAYER, map::chunk::CHANGE_REMOVE);
+  if (chunk->mobs[i] != objects::NO_HANDLE)
+    chunk->journal.record(i, map::chunk::MOB_LAYER, map::chunk::CHANGE_REMOVE);
+  if (keepObjects == false)
+    chunks.worldObjects.clear(chunk->objects[i]);
+  chunks.mobObjects.clear(chunk->mobs[i]);
+  updatePassability(chunk, i);
+}
+
+// Rewrites a tile and keeps a sliding report that covers it in step with the map
+TypeId MapController::updateTile (map::chunk::SlidingReport* r, int z, int x, int y, TypeId biomeType, TypeId terrainType)
+{
+  if (r->contains(z, x, y) == false)
+    return updateTile(z, x, y, biomeType, terrainType);
+  {
+    map::chunk::ChunkStore::CellReader cells (chunks);
+    countTileInReport(cells, r, x, y, true);
+  }
+  auto b = updateTile(z, x, y, biomeType, terrainType);
+  map::chunk::ChunkStore::CellReader cells (chunks);
+  countTileInReport(cells, r, x, y, false);
+  r->rerank(cfg->terrainTypesById.size(), cfg->biomeTypesById.size());
+  return b;
+}
+
+void MapController::placeObject (int z, int x, int y, objects::Handle w)
+{
+  std::unique_lock lock(chunks.cellLock(z, x, y));
+  auto chunk = chunks.findOrCreate(z, x, y);
+  int i = map::chunk::toLocalIndex(x, y);
+  chunks.worldObjects.push(chunk->objects[i], w);
+  chunk->journal.record(i, map::chunk::OBJECT_LAYER, map::chunk::CHANGE_ADD);
+  chunk->delta.objects = chunk->delta.objects || !generating();
+  updatePassability(chunk, i);
+  chunks.handOff(chunk);
+}
+
+void MapController::placeMob (int z, int x, int y, objects::Handle m)
+{
+  std::unique_lock lock(chunks.cellLock(z, x, y));
+  auto chunk = chunks.findOrCreate(z, x, y);
+  int i = map::chunk::toLocalIndex(x, y);
+  chunks.mobObjects.push(chunk->mobs[i], m);
+  chunk->journal.record(i, map::chunk::MOB_LAYER, map::chunk::CHANGE_ADD);
+  chunk->delta.mobs = chunk->delta.mobs || !generating();
+  updatePassability(chunk, i);
+  chunks.handOff(chunk);
+}
+
+// Bulk forms of placeObject and placeMob; a tile's list ends up in the same order as placing them one by one
+void MapController::placeObjects (std::vector<Placement>& placements)
+{
+  forEachByChunk(placements, [this](map::chunk::Chunk* chunk, Placement& p) {
+    int i = map::chunk::toLocalIndex(p.x, p.y);
+    chunks.worldObjects.push(chunk->objects[i], p.handle);
+    chunk->journal.record(i, map::chunk::OBJECT_LAYER, map::chunk::CHANGE_ADD);
+    chunk->delta.objects = chunk->delta.objects || !generating();
+    updatePassability(chunk, i);
+  });
+}
+
+void MapController::placeMobs (std::vector<Placement>& placements)
+{
+  forEachByChunk(placements, [this](map::chunk::Chunk* chunk, Placement& p) {
+    int i = map::chunk::toLocalIndex(p.x, p.y);
+    chunks.mobObjects.push(chunk->mobs[i], p.handle);
+    chunk->journal.record(i, map::chunk::MOB_LAYER, map::chunk::CHANGE_ADD);
+    chunk->delta.mobs = chunk->delta.mobs || !generating();
+    updatePassability(chunk, i);
+  });
+}
+
+// Recomputes a cell's passable bit; every write to a cell's terrain, objects or mobs must call this
+void MapController::updatePassability (map::chunk::Chunk* chunk, int i)
+{
+  bool passable = chunk->generated[i] && !cfg->getTerrainType(chunk->terrain[i].terrainId)->impassable;
+  chunks.worldObjects.forEach(chunk->objects[i], [&passable](objects::Handle h, WorldObject* o) {
+    passable = passable && !o->objectType->impassable;
+  });
+  chunks.mobObjects.forEach(chunk->mobs[i], [&passable](objects::Handle h, MobObject* m) {
+    passable = passable && !m->mobType->impassable;
+  });
+  chunk->passable[i] = passable;
+  chunk->dirty = true;
+  // Chunks being generated are handed off once their whole column is done
+  if (!generating())
+    chunk->unpublished = true;
 }
 
-bool MapController::isPassable (std::tuple<int, int, int> coords)
+bool MapController::isPassable (std::tuple<int, int, int> coords, bool block)
 {
   auto [_z, _x, _y] = coords;
-  auto terrainIt = terrainMap[_z].find({ _x, _y });
-  if (terrainIt == terrainMap[_z].end())
-    return false;
-  else if (terrainIt->second.terrainType->impassable)
-    return false;
-  auto worldIt = worldMap[_z].find({ _x, _y });
-  if (worldIt != worldMap[_z].end())
-    for (auto o : worldIt->second)
-      if (o->objectType->impassable)
-        return false;
-  auto mobIt = mobMap[_z].find({ _x, _y });
-  if (mobIt != mobMap[_z].end())
-    for (auto o : mobIt->second)
-      if (o->mobType->impassable)
-        return false;
-  return true;
+  return chunks.isPassable(_z, _x, _y, block);
 }
 
 #endif
\ No newline at end of file
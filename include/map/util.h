@@ -5,8 +5,6 @@
 
 using namespace map;
 
-std::shared_mutex mtx;
-
 std::map<int, std::vector<SDL_Point>> MapController::getAllPointsInRect(Rect* r)
 {
   std::map<int, std::vector<SDL_Point>> results;
@@ -27,77 +25,151 @@ std::map<int, std::vector<SDL_Point>> MapController::getAllPointsInRect(Rect* r)
 }
 
 
-std::map<int, std::map<std::string, int>> MapController::getTilesInRange (Rect* r)
+// Calls whole(z, histogram) for each chunk lying entirely inside the rect (edges included) and tile(z, terrain)
+// for each generated tile of the chunks it only partly covers, so the cost grows with the chunks covered
+// rather than the tiles
+template <typename F, typename G>
+void MapController::accumulateRange (Rect* r, F whole, G tile)
 {
-  std::map<int, std::map<std::string, int>> t;
-  auto lambda = [this, &t](int h, int i, int j)
+  map::chunk::ChunkStore::CellReader cells (chunks);
+  for (auto h = 0; h < maxDepth; h++)
+    for (auto cx = map::chunk::toChunkCoordinate(r->x1); cx <= map::chunk::toChunkCoordinate(r->x2); cx++)
+      for (auto cy = map::chunk::toChunkCoordinate(r->y1); cy <= map::chunk::toChunkCoordinate(r->y2); cy++)
+      {
+        int x1 = cx << map::chunk::CHUNK_SHIFT;
+        int y1 = cy << map::chunk::CHUNK_SHIFT;
+        int x2 = x1 + map::chunk::CHUNK_MASK;
+        int y2 = y1 + map::chunk::CHUNK_MASK;
+        if (r->x1 <= x1 && x2 <= r->x2 && r->y1 <= y1 && y2 <= r->y2)
+        {
+          // histogram takes the chunk's cell lock, and only lockCells may hold two
+          cells.release();
+          chunks.histogram(h, cx, cy, [&whole, h](const map::chunk::TypeHistogram& t) { whole(h, t); });
+          continue;
+        }
+        for (auto i = std::max(x1, r->x1); i <= std::min(x2, r->x2); i++)
+          for (auto j = std::max(y1, r->y1); j <= std::min(y2, r->y2); j++)
+          {
+            cells.at(h, i, j);
+            if (auto terrain = findTerrain(h, i, j))
+              tile(h, *terrain);
+          }
+      }
+}
+
+namespace
+{
+  void addCounts (std::map<TypeId, int>& counts, const std::vector<std::uint16_t>& histogram)
   {
-    if (terrainMap[h].find({ i, j }) != terrainMap[h].end())
-      t[h][terrainMap[h][{i, j}].terrainType->name] += 1;
-  };
-  processChunk(r, lambda);
+    for (std::size_t id = 0; id < histogram.size(); id++)
+      if (histogram[id] > 0)
+        counts[id] += histogram[id];
+  }
+}
+
+std::map<int, std::map<TypeId, int>> MapController::getTilesInRange (Rect* r)
+{
+  std::map<int, std::map<TypeId, int>> t;
+  accumulateRange(r,
+    [&t](int h, const map::chunk::TypeHistogram& histogram) { addCounts(t[h], histogram.terrain); },
+    [&t](int h, const TerrainObject& terrain) { t[h][terrain.terrainId] += 1; });
   return t;
 }
 
 
-std::map<int, std::map<std::string, std::map<std::string, int>>> MapController::getCountsInRange (Rect* r)
+std::map<int, std::map<std::string, std::map<TypeId, int>>> MapController::getCountsInRange (Rect* r)
 {
-  std::map<int, std::map<std::string, std::map<std::string, int>>> res;
-  auto lambda = [this, &res](int h, int i, int j)
-  {
-    auto it = terrainMap[h].find({ i, j });
-    if (it != terrainMap[h].end())
-    {
-      res[h]["terrain"][it->second.terrainType->name]++;
-      res[h]["biome"][it->second.biomeType->name]++;
-    }
-  };
-  processChunk(r, lambda);
+  std::map<int, std::map<std::string, std::map<TypeId, int>>> res;
+  accumulateRange(r,
+    [&res](int h, const map::chunk::TypeHistogram& histogram) {
+      addCounts(res[h]["terrain"], histogram.terrain);
+      addCounts(res[h]["biome"], histogram.biome);
+    },
+    [&res](int h, const TerrainObject& terrain) {
+      res[h]["terrain"][terrain.terrainId]++;
+      res[h]["biome"][terrain.biomeId]++;
+    });
   return res;
 }
 
 
 
-std::map<int, std::map<std::string, int>> MapController::getBiomesInRange (Rect* rangeRect)
+std::map<int, std::map<TypeId, int>> MapController::getBiomesInRange (Rect* rangeRect)
 {
-  std::map<int, std::map<std::string, int>> results;
-  auto lambda = [this, &results](int h, int i, int j)
-  {
-    if (terrainMap[h].find({ i, j }) != terrainMap[h].end())
-      results[h][terrainMap[h][{i, j}].biomeType->name] += 1;
-  };
-  processChunk(rangeRect, lambda);
+  std::map<int, std::map<TypeId, int>> results;
+  accumulateRange(rangeRect,
+    [&results](int h, const map::chunk::TypeHistogram& histogram) { addCounts(results[h], histogram.biome); },
+    [&results](int h, const TerrainObject& terrain) { results[h][terrain.biomeId] += 1; });
   return results;
 }
 
 
 map::chunk::ChunkReport MapController::generateRangeReport(Rect* range, int h = 0)
 {
-  std::unique_lock lock(mtx);
-  auto t = map::chunk::getRangeReport([this, h](int x, int y, map::chunk::ChunkReport* r){
-    auto it = terrainMap[h].find({x, y});
-    if (it != terrainMap[h].end())
-    {
-      r->terrainCounts[h][it->second.terrainType->name]++;
-      auto [ topTerrainCount, topTerrainName ] = r->topTerrain[h];
-      if (r->terrainCounts[h][it->second.terrainType->name] > topTerrainCount)
-      {
-        r->meta[h]["secondTopTerrain"] = topTerrainName;
-        r->topTerrain[h] = { r->terrainCounts[h][it->second.terrainType->name], it->second.terrainType->name };
-      }
-      if (cfg->biomeExistsOnLevel(it->second.biomeType->name, h) == true)
-      {
-        r->biomeCounts[h][it->second.biomeType->name]++;
-        auto [ topBiomeCount, topBiomeName ] = r->topBiome[h];
-        if (r->biomeCounts[h][it->second.biomeType->name] > topBiomeCount)
-        {
-          r->meta[h]["secondTopBiome"] = topBiomeCount;
-          r->topBiome[h] = { r->biomeCounts[h][it->second.biomeType->name], it->second.biomeType->name };
-        }
-      }
-    }
-  }, range, 1, 1);
+  map::chunk::ChunkStore::CellReader cells (chunks);
+  auto t = map::chunk::getRangeReport([this, &cells](int x, int y, map::chunk::ChunkReport* r){
+    countTileInReport(cells, r, x, y, false);
+  }, range, h);
   return t;
 }
 
+void MapController::countTileInReport(map::chunk::ChunkStore::CellReader& cells, map::chunk::ChunkReport* r, int x, int y, bool remove)
+{
+  cells.at(r->z, x, y);
+  auto terrain = findTerrain(r->z, x, y);
+  if (terrain == nullptr)
+    return;
+  bool countBiome = cfg->biomeExistsOnLevel(terrain->biomeId, r->z);
+  if (remove)
+  {
+    r->removeTerrain(terrain->terrainId);
+    if (countBiome)
+      r->removeBiome(terrain->biomeId);
+  }
+  else
+  {
+    r->addTerrain(terrain->terrainId);
+    if (countBiome)
+      r->addBiome(terrain->biomeId);
+  }
+}
+
+// Reports belong to their caller, so only the cells they read are locked
+void MapController::moveRangeReport(map::chunk::SlidingReport* r, int x, int y)
+{
+  map::chunk::ChunkStore::CellReader cells (chunks);
+  int dx = x - r->x;
+  int dy = y - r->y;
+  if (r->placed == false || std::abs(dx) + std::abs(dy) != 1)
+  {
+    static_cast<map::chunk::ChunkReport&>(*r) = map::chunk::ChunkReport(r->z);
+    for (auto i = x - r->radius; i < x + r->radius; i++)
+      for (auto j = y - r->radius; j < y + r->radius; j++)
+        countTileInReport(cells, r, i, j, false);
+    r->placed = true;
+  }
+  else if (dy != 0)
+  {
+    int leaving = dy > 0 ? r->y - r->radius : r->y + r->radius - 1;
+    int entering = dy > 0 ? y + r->radius - 1 : y - r->radius;
+    // A row at a time, so the reader changes locks at most once per chunk crossed
+    for (auto i = x - r->radius; i < x + r->radius; i++)
+      countTileInReport(cells, r, i, leaving, true);
+    for (auto i = x - r->radius; i < x + r->radius; i++)
+      countTileInReport(cells, r, i, entering, false);
+  }
+  else
+  {
+    int leaving = dx > 0 ? r->x - r->radius : r->x + r->radius - 1;
+    int entering = dx > 0 ? x + r->radius - 1 : x - r->radius;
+    for (auto j = y - r->radius; j < y + r->radius; j++)
+      countTileInReport(cells, r, leaving, j, true);
+    for (auto j = y - r->radius; j < y + r->radius; j++)
+      countTileInReport(cells, r, entering, j, false);
+  }
+  r->x = x;
+  r->y = y;
+  r->rerank(cfg->terrainTypesById.size(), cfg->biomeTypesById.size());
+}
+
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define GAME_MOB_OBJECT_H
 
 #include "simulated.h"
+#include "rng.h"
 
 struct MobObject : SimulatedObject
 {
@@ -9,8 +10,8 @@ struct MobObject : SimulatedObject
   int speed;
   MobType* mobType;
   std::map<std::string, Timer> mobTimers;
-  std::vector<std::shared_ptr<simulated::Simulator<MobObject>>> simulators;
-  MobObject (int x, int y, int z, MobType* m, BiomeType* b)
+  std::vector<simulated::Simulator<MobObject>> simulators;
+  MobObject (int x, int y, int z, MobType* m, TypeId b)
   {
     type = tileObject::MOB;
     id = uuid::generate_uuid_v4();
@@ -19,8 +20,8 @@ struct MobObject : SimulatedObject
     this->y = y;
     this->z = z;
     mobType = m;
-    biomeType = b;
-    speed = std::rand() % 1500 + 1000;
+    biomeId = b;
+    speed = rng::next() % 1500 + 1000;
     Timer t;
     t.start();
     mobTimers["movement"] = t;
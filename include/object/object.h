@@ -6,6 +6,5 @@
 #include "world.h"
 #include "simulated.h"
 #include "mob.h"
-#include "biome.h"
 
 #endif
\ No newline at end of file
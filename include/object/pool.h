@@ -0,0 +1,147 @@
+#ifndef GAME_OBJECT_POOL_H
+#define GAME_OBJECT_POOL_H
+
+#include "SDL2/SDL.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace objects
+{
+  // Low 24 bits index a pool slot, high 8 bits are the slot's generation when the handle was issued
+  typedef std::uint32_t Handle;
+  const Handle NO_HANDLE = 0xFFFFFFFF;
+
+  // Slab allocator for map objects. Slabs are never freed or moved, so a live object's address is stable
+  // and lookups don't need the pool lock. Each slot also carries the link for the per-tile list it is on.
+  template <typename T>
+  struct ObjectPool
+  {
+    static const int INDEX_BITS = 24;
+    static const std::uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const int SLAB_SHIFT = 10;
+    static const std::uint32_t SLAB_SIZE = 1u << SLAB_SHIFT;
+    static const std::uint32_t MAX_SLABS = (INDEX_MASK + 1) >> SLAB_SHIFT;
+    struct Slot
+    {
+      std::optional<T> object;
+      Handle next = NO_HANDLE;
+      std::uint8_t generation = 0;
+    };
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    std::vector<std::uint32_t> freeSlots;
+    std::atomic<std::uint32_t> size;
+    // Changed under poolMtx, read without it
+    std::atomic<std::size_t> live;
+    std::mutex poolMtx;
+    ObjectPool () : size(0), live(0) { slabs.reserve(MAX_SLABS); }
+    ObjectPool (ObjectPool&& other) { *this = std::move(other); }
+    ObjectPool& operator= (ObjectPool&& other)
+    {
+      std::unique_lock lock(poolMtx);
+      slabs = std::move(other.slabs);
+      slabs.reserve(MAX_SLABS);
+      freeSlots = std::move(other.freeSlots);
+      size = other.size.load();
+      live = other.live.load();
+      return *this;
+    }
+    Slot& slot (std::uint32_t index) { return slabs[index >> SLAB_SHIFT][index & (SLAB_SIZE - 1)]; }
+    template <typename... Args>
+    Handle create (Args&&... args)
+    {
+      std::unique_lock lock(poolMtx);
+      std::uint32_t index;
+      if (freeSlots.size())
+      {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+      }
+      else
+      {
+        index = size;
+        if (index >= INDEX_MASK)
+        {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Object pool is full");
+          return NO_HANDLE;
+        }
+        if ((index & (SLAB_SIZE - 1)) == 0)
+          slabs.push_back(std::make_unique<Slot[]>(SLAB_SIZE));
+        size = index + 1;
+      }
+      auto& s = slot(index);
+      s.object.emplace(std::forward<Args>(args)...);
+      s.next = NO_HANDLE;
+      live++;
+      return (static_cast<Handle>(s.generation) << INDEX_BITS) | index;
+    }
+    T* get (Handle h)
+    {
+      std::uint32_t index = h & INDEX_MASK;
+      if (h == NO_HANDLE || index >= size)
+        return nullptr;
+      auto& s = slot(index);
+      return s.object && s.generation == (h >> INDEX_BITS) ? &*s.object : nullptr;
+    }
+    void destroy (Handle h)
+    {
+      std::unique_lock lock(poolMtx);
+      std::uint32_t index = h & INDEX_MASK;
+      if (h == NO_HANDLE || index >= size)
+        return;
+      auto& s = slot(index);
+      if (!s.object || s.generation != (h >> INDEX_BITS))
+        return;
+      s.object.reset();
+      s.next = NO_HANDLE;
+      // A slot whose generation wraps is retired for good, since a stale handle to it would match again
+      if (++s.generation != 0)
+        freeSlots.push_back(index);
+      live--;
+    }
+    Handle next (Handle h) { return slot(h & INDEX_MASK).next; }
+    void push (Handle& head, Handle h)
+    {
+      slot(h & INDEX_MASK).next = head;
+      head = h;
+    }
+    bool unlink (Handle& head, Handle h)
+    {
+      for (Handle* link = &head; *link != NO_HANDLE; link = &slot(*link & INDEX_MASK).next)
+        if (*link == h)
+        {
+          *link = next(h);
+          slot(h & INDEX_MASK).next = NO_HANDLE;
+          return true;
+        }
+      return false;
+    }
+    void clear (Handle& head)
+    {
+      while (head != NO_HANDLE)
+      {
+        Handle n = next(head);
+        destroy(head);
+        head = n;
+      }
+    }
+    // f may move or destroy the object it is handed
+    template <typename F>
+    void forEach (Handle head, F f)
+    {
+      for (Handle h = head; h != NO_HANDLE; )
+      {
+        Handle n = next(h);
+        if (auto o = get(h))
+          f(h, o);
+        h = n;
+      }
+    }
+  };
+}
+
+#endif
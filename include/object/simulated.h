@@ -2,6 +2,7 @@
 #define GAME_SIMULATED_OBJECT_H
 
 #include "tile.h"
+#include "rng.h"
 #include <memory>
 #include <tuple>
 
@@ -31,7 +32,7 @@ namespace simulated
         _fn = fn;
         _id = uuid::generate_uuid_v4();
         _timer.start();
-        _frequency = 3000 + std::rand() % 1000;
+        _frequency = 3000 + rng::next() % 1000;
       }
       void simulate ()
       {
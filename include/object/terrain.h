@@ -2,20 +2,25 @@
 #define GAME_TERRAIN_OBJECT_H
 
 #include "tile.h"
+#include <cstdint>
 
-struct TerrainObject : Tile
+// Terrain never moves and animates per type, so a cell only records what was placed there.
+// Position comes from the cell's slot in its chunk and animation from TerrainType::getAnimationFrame.
+struct TerrainObject
 {
-  TerrainType* terrainType;
-  TerrainObject () { type = tileObject::TERRAIN; }
-  TerrainObject (int x, int y, int z, BiomeType* b, TerrainType* t)
+  TypeId biomeId;
+  TypeId terrainId;
+  bool initialized;
+  TerrainObject () : biomeId(NO_TYPE), terrainId(NO_TYPE), initialized(false) {}
+  TerrainObject (TypeId b, TypeId t) : biomeId(b), terrainId(t), initialized(false) {}
+  static std::uint32_t hashPosition (int z, int x, int y)
   {
-    type = tileObject::TERRAIN;
-    this->x = x;
-    this->y = y;
-    this->z = z;
-    biomeType = b;
-    terrainType = t;
+    std::uint32_t h = static_cast<std::uint32_t>(x) * 0x8DA6B343u ^ static_cast<std::uint32_t>(y) * 0xD8163841u ^ static_cast<std::uint32_t>(z) * 0xCB1AB31Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
   }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -30,8 +30,8 @@ struct Tile
   int z;
   int x;
   int y;
-  BiomeType* biomeType;
-  TerrainType* terrainType;
+  TypeId biomeId;
+  TypeId terrainId;
   Timer animationTimer;
   int animationFrame;
   int animationSpeed;
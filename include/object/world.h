@@ -7,14 +7,14 @@ struct WorldObject : Tile
 {
   ObjectType* objectType;
   WorldObject() { type = tileObject::WORLD; }
-  WorldObject(int x, int y, int z, ObjectType* o, BiomeType* b)
+  WorldObject(int x, int y, int z, ObjectType* o, TypeId b)
   {
     type = tileObject::WORLD;
     this->x = x;
     this->y = y;
     this->z = z;
     objectType = o;
-    biomeType = b;
+    biomeId = b;
   }
 };
 
@@ -6,6 +6,7 @@
 #include "uuid.h"
 #include "type/type.h"
 #include "object/object.h"
+#include "object/pool.h"
 
 #include <algorithm>
 #include <chrono>
@@ -33,11 +34,6 @@ namespace objects
   typedef std::map<std::string, BiomeType> biomeTypesMap;
   typedef std::map<std::string, TerrainType> terrainTypesMap;
   typedef std::map<std::string, TileType> tileTypesMap;
-  typedef std::vector<std::shared_ptr<WorldObject>> objectsVector;
-  typedef std::map<int, std::map<std::pair<int, int>, BiomeObject>> biomeMap;
-  typedef std::map<int, std::map<std::pair<int, int>, TerrainObject>> terrainMap;
-  typedef std::map<int, std::map<std::pair<int, int>, std::vector<std::shared_ptr<WorldObject>>>> worldMap;
-  typedef std::map<int, std::map<std::pair<int, int>, std::vector<std::shared_ptr<MobObject>>>> mobMap;
 }
 
 #endif
@@ -2,6 +2,8 @@
 #define GAME_RECT_H
 
 #include "SDL2/SDL.h"
+#include "executor.h"
+#include "rng.h"
 #include <cmath>
 #include <functional>
 #include <random>
@@ -22,14 +24,14 @@ struct Rect
   void set(std::tuple<int, int, int, int> data) { auto [_x1, _y1, _x2, _y2] = data; x1 = _x1; y1 =_y1; x2 =_x2; y2 = _y2; }
   std::tuple<int, int, int, int> get(){ return std::make_tuple(x1, y1, x2, y2 ); };
   SDL_Rect* getSDL_Rect () { auto r = new SDL_Rect(); r->x = x1; r->y = y1; r->w = x2; r->h = y2; return r; }
-  int getWidth () { return std::abs(x1) + std::abs(x2); }
-  int getHeight () { return std::abs(y1) + std::abs(y2); }
+  int getWidth () { return x2 - x1; }
+  int getHeight () { return y2 - y1; }
   std::pair<int, int> getDimensions () { return { getWidth(), getHeight() }; }
   std::tuple<int, int> getMid (){ return std::make_tuple(std::floor((x1 + x2)/2), std::floor((y1 + y2)/2)); }
-  std::vector<Rect>* getRects(bool shuffle = false) // TODO: Don't clear every time, create different method
+  std::vector<Rect>* getRects(bool shuffle = false, int divisions = 25) // TODO: Don't clear every time, create different method
   {
-    int small_w = 25;
-    int small_h = 25;
+    int small_w = divisions;
+    int small_h = divisions;
     int w = getWidth();
     int h = getHeight();
     auto result_w = std::div(w, small_w);
@@ -43,9 +45,8 @@ struct Rect
       }
     if (shuffle == true)
     {
-      unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-      std::default_random_engine rng(seed);
-      std::shuffle(rects.begin(), rects.end(), rng);
+      std::default_random_engine engine(rng::next());
+      std::shuffle(rects.begin(), rects.end(), engine);
     }
     return &rects;
   }
@@ -53,13 +54,13 @@ struct Rect
   void multiprocess(std::function<void(int, int)> f, Rect* r = NULL, int fuzz = 1)
   {
     if (r == NULL)
-      r->set({ x1, y1, x2, y2 });
-    for (auto i = x1; i < x2; i += 1 + std::rand() % fuzz)
-      for (auto j = y1; j < y2; j += 1 + std::rand() % fuzz)
-      {
-        std::thread t([&f, i, j]() { f(i, j); });
-        t.join();
-      }
+      r = this;
+    // Tiles are picked on the calling thread so its random stream decides the pattern, then run on the executor
+    std::vector<SDL_Point> tiles;
+    for (auto i = r->x1; i < r->x2; i += 1 + rng::next() % fuzz)
+      for (auto j = r->y1; j < r->y2; j += 1 + rng::next() % fuzz)
+        tiles.push_back({ i, j });
+    executor::parallelFor(0, static_cast<int>(tiles.size()), [&f, &tiles](int n) { f(tiles[n].x, tiles[n].y); }, 64);
   }
 };
 
@@ -0,0 +1,65 @@
+#ifndef GAME_RNG_H
+#define GAME_RNG_H
+
+#include <cstdint>
+
+// Random numbers for map generation, all counter-based: a draw is a hash of a key and a counter, so there is no
+// shared state to contend on and the same key always gives the same numbers, whatever thread asks.
+namespace rng
+{
+  // What a generation draw is for. Part of every key, so two passes over the same tile draw unrelated numbers.
+  enum pass : std::uint64_t
+  {
+    COLUMN = 1,
+    BRUSH,
+    TERRAIN,
+    MOB,
+    FUDGE,
+    HAMMER,
+    REFUDGE,
+    CLEAN
+  };
+
+  inline thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+  inline std::uint64_t mix (std::uint64_t z)
+  {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  inline std::uint64_t key (std::uint64_t seed, int z, int x, int y, pass p)
+  {
+    auto k = mix(seed + p);
+    k = mix(k + static_cast<std::uint32_t>(z));
+    return mix(k + (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32 | static_cast<std::uint32_t>(y)));
+  }
+
+  // splitmix64 from key at position n; non-negative like std::rand so `% n` call sites read the same
+  inline int at (std::uint64_t key, std::uint64_t n = 0)
+  {
+    return static_cast<int>(mix(key + (n + 1) * 0x9E3779B97F4A7C15ull) >> 33);
+  }
+
+  // Successive draws for one key, for decisions that need more than one number
+  struct Stream
+  {
+    std::uint64_t key;
+    std::uint64_t n;
+    explicit Stream (std::uint64_t key) : key(key), n(0) {}
+    int next () { return at(key, n++); }
+  };
+
+  // This thread's stream, for decisions that follow from the ones before them, such as the order and shape of a
+  // column's brush strokes; generateChunk keys it by column
+  inline void seed (std::uint64_t s) { state = s; }
+
+  inline int next ()
+  {
+    state += 0x9E3779B97F4A7C15ull;
+    return static_cast<int>(mix(state) >> 33);
+  }
+}
+
+#endif
@@ -1,20 +1,25 @@
 #ifndef GAME_BIOME_TYPE_H
 #define GAME_BIOME_TYPE_H
 
-#include <map>
+#include "id.h"
+#include "rng.h"
+#include "weighted.h"
 #include <string>
+#include <utility>
 #include <vector>
 
 struct BiomeType
 {
+  TypeId id;
   std::string name;
   int maxDepth;
   int minDepth;
-  std::map<int, std::pair<std::string, float>> terrainTypes;
+  std::vector<std::pair<TypeId, float>> terrainTypes;
   float multiplier;
-  std::vector<std::string> terrainTypeProbabilities;
+  WeightedTypes terrainTypeWeights;
   BiomeType () {}
-  std::string getRandomTerrainTypeName() { return terrainTypeProbabilities.at(std::rand() % terrainTypeProbabilities.size()); }
+  TypeId getRandomTerrainTypeId(int r) { return terrainTypeWeights.pick(r); }
+  TypeId getRandomTerrainTypeId() { return getRandomTerrainTypeId(rng::next()); }
 };
 
 #endif
\ No newline at end of file
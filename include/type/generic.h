@@ -1,12 +1,14 @@
 #ifndef GAME_GENERIC_TYPE_H
 #define GAME_GENERIC_TYPE_H
 
+#include "id.h"
 #include "sprite.h"
 #include <map>
 #include <string>
 
 struct GenericType
 {
+  TypeId id;
   std::string name;
   bool impassable;
   float multiplier;
@@ -0,0 +1,12 @@
+#ifndef GAME_TYPE_ID_H
+#define GAME_TYPE_ID_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Types are interned at config load time; ids index the ConfigurationController's *ById tables
+typedef std::uint16_t TypeId;
+const TypeId NO_TYPE = 0xFFFF;
+const std::size_t MAX_TYPE_IDS = 256;
+
+#endif
@@ -13,7 +13,7 @@ struct MobType : ObjectType
     bool clusters,
     std::map<int, std::map<int, Sprite*>> animationMap,
     int animationSpeed,
-    std::map<std::string, int> biomes
+    std::bitset<MAX_TYPE_IDS> biomes
   )
   {
     this->name = name;
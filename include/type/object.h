@@ -2,10 +2,11 @@
 #define GAME_OBJECT_TYPE_H
 
 #include "generic.h"
+#include <bitset>
 
 struct ObjectType : GenericType
 {
-  std::map<std::string, int> biomes;
+  std::bitset<MAX_TYPE_IDS> biomes;
   ObjectType() {};
   ObjectType(
     std::string name,
@@ -14,7 +15,7 @@ struct ObjectType : GenericType
     bool clusters,
     std::map<int, std::map<int, Sprite*>> animationMap,
     int animationSpeed,
-    std::map<std::string, int> biomes
+    std::bitset<MAX_TYPE_IDS> biomes
   )
   {
     this->name = name;
@@ -25,7 +26,7 @@ struct ObjectType : GenericType
     this->animationSpeed = animationSpeed;
     this->biomes = biomes;
   }
-  bool canExistIn(std::string biomeName) { return biomes[biomeName] == 1; }
+  bool canExistIn(TypeId biome) { return biomes[biome]; }
 };
 
 #endif
\ No newline at end of file
@@ -2,19 +2,21 @@
 #define GAME_TERRAIN_TYPE_H
 
 #include "generic.h"
+#include "rng.h"
+#include "weighted.h"
 #include <vector>
 
 struct TerrainType : GenericType
 {
-  std::vector<std::string> objects;
+  std::vector<TypeId> objects;
   int objectFrequencyMultiplier;
-  std::vector<std::string> objectTypeProbabilities;
+  WeightedTypes objectTypeWeights;
   TerrainType () {}
   TerrainType(
     std::string name,
-    std::vector<std::string> relatedObjectTypes,
+    std::vector<TypeId> relatedObjectTypes,
     float objectFrequencyMultiplier,
-    std::vector<std::string> relatedObjectTypeProbabilities,
+    WeightedTypes relatedObjectTypeWeights,
     bool impassable,
     float multiplier,
     bool clusters
@@ -23,15 +25,25 @@ struct TerrainType : GenericType
     this->name = name;
     this->objects = relatedObjectTypes;
     this->objectFrequencyMultiplier = objectFrequencyMultiplier;
-    this->objectTypeProbabilities = relatedObjectTypeProbabilities;
+    this->objectTypeWeights = relatedObjectTypeWeights;
     this->impassable = impassable;
     this->multiplier = multiplier;
     this->clusters = clusters;
   };
   int getObjectFrequencyMultiplier() { if (objectFrequencyMultiplier > 0) return objectFrequencyMultiplier; else return 1; }
-  std::string getRandomObjectTypeName()
+  TypeId getRandomObjectTypeId(int r)
   {
-    return objectTypeProbabilities.at(rand() % objectTypeProbabilities.size());
+    return objectTypeWeights.pick(r);
+  }
+  TypeId getRandomObjectTypeId() { return getRandomObjectTypeId(rng::next()); }
+  // Cells share their type's animation; the cell hash staggers speed and phase so neighbours don't flip in lockstep
+  int getAnimationFrame(unsigned int ticks, std::uint32_t cellHash)
+  {
+    int frames = maxFrames();
+    if (!isAnimated() || frames < 2)
+      return 0;
+    unsigned int speed = animationSpeed + cellHash % 3000;
+    return ((ticks + (cellHash >> 12)) / speed) % frames;
   }
 };
 
@@ -1,11 +1,13 @@
 #ifndef GAME_TYPE_H
 #define GAME_TYPE_H
 
+#include "id.h"
 #include "generic.h"
 #include "terrain.h"
 #include "tile.h"
 #include "object.h"
 #include "mob.h"
 #include "biome.h"
+#include "weighted.h"
 
 #endif
\ No newline at end of file
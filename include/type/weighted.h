@@ -0,0 +1,79 @@
+#ifndef GAME_WEIGHTED_TYPE_H
+#define GAME_WEIGHTED_TYPE_H
+
+#include "id.h"
+#include "rng.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Picks type ids in proportion to their weights in constant time, using Walker's alias method with Vose's
+// construction. Weights may be fractional; each is kept to within 2^-32 of a column, rather than rounded to the
+// tenth it took when ids were repeated 10 * weight times.
+struct WeightedTypes
+{
+  std::vector<std::pair<TypeId, float>> weights;
+  std::vector<TypeId> ids;
+  std::vector<TypeId> aliases;
+  // Out of 2^32: a draw landing in column i keeps ids[i] below threshold[i], and takes aliases[i] otherwise
+  std::vector<std::uint64_t> thresholds;
+
+  // Ids with no weight are kept in weights but can't be picked
+  void add (TypeId id, float weight) { weights.push_back({ id, weight > 0 ? weight : 0 }); }
+  bool empty () const { return ids.empty(); }
+
+  // Call once every id is added
+  void build ()
+  {
+    double total = 0;
+    for (auto [id, w] : weights)
+      total += w;
+    ids.clear();
+    aliases.clear();
+    thresholds.clear();
+    if (total <= 0)
+      return;
+    for (auto [id, w] : weights)
+      if (w > 0)
+        ids.push_back(id);
+    auto n = ids.size();
+    aliases = ids;
+    thresholds.assign(n, std::uint64_t(1) << 32);
+    std::vector<double> scaled;
+    std::vector<std::size_t> small;
+    std::vector<std::size_t> large;
+    for (auto [id, w] : weights)
+      if (w > 0)
+      {
+        scaled.push_back(w * n / total);
+        (scaled.back() < 1 ? small : large).push_back(scaled.size() - 1);
+      }
+    while (small.size() && large.size())
+    {
+      auto s = small.back();
+      small.pop_back();
+      auto l = large.back();
+      thresholds[s] = static_cast<std::uint64_t>(scaled[s] * 4294967296.0);
+      aliases[s] = ids[l];
+      scaled[l] -= 1 - scaled[s];
+      if (scaled[l] < 1)
+      {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // Whatever is left is 1 up to rounding, so keeps its own column
+  }
+
+  // r is any draw, such as rng::next() or rng::at(key); NO_TYPE if nothing can be picked
+  TypeId pick (int r) const
+  {
+    if (ids.empty())
+      return NO_TYPE;
+    auto h = rng::mix(static_cast<std::uint32_t>(r));
+    auto column = ((h >> 32) * ids.size()) >> 32;
+    return (h & 0xFFFFFFFFull) < thresholds[column] ? ids[column] : aliases[column];
+  }
+};
+
+#endif
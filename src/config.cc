@@ -38,6 +38,44 @@ animationMap ConfigurationController::configureAnimationMap (int i, std::string
   return m;
 };
 
+// Ids are handed out in declaration order, skipping repeated names, and byId gets a slot for each. entries[id] is
+// the index in the configuration the type is read from.
+template <typename T>
+std::map<std::string, TypeId> ConfigurationController::internTypeNames (std::string n, std::vector<T*>& byId, std::vector<Json::ArrayIndex>& entries)
+{
+  std::map<std::string, TypeId> ids;
+  byId.clear();
+  entries.clear();
+  for (Json::ArrayIndex i = 0; i < configJson[n].size(); ++i)
+  {
+    if (ids.size() >= MAX_TYPE_IDS)
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Too many %s: only the first %lu are loaded", n.c_str(), MAX_TYPE_IDS);
+      break;
+    }
+    auto name = configJson[n][i]["name"].asString();
+    if (!ids.emplace(name, static_cast<TypeId>(byId.size())).second)
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Duplicate name '%s' in %s: only the first is loaded", name.c_str(), n.c_str());
+      continue;
+    }
+    byId.push_back(nullptr);
+    entries.push_back(i);
+  }
+  return ids;
+}
+
+TypeId ConfigurationController::getTypeId (std::map<std::string, TypeId>& ids, std::string name)
+{
+  auto it = ids.find(name);
+  if (it == ids.end())
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unknown type '%s' referenced in configuration", name.c_str());
+    return NO_TYPE;
+  }
+  return it->second;
+}
+
 ConfigurationController::ConfigurationController (std::string configFilePath, std::map<std::string, Sprite> s)
 {
 
@@ -53,55 +91,79 @@ ConfigurationController::ConfigurationController (std::string configFilePath, st
   gameSize = configJson["gameSize"].asInt();
   tileSize = configJson["tileSize"].asInt();
   spriteSize = configJson["spriteSize"].asInt();
+  // Chunks farther than this many tiles from the camera are kept packed
+  residentRadius = configJson["map"]["chunks"].isMember("residentRadius")
+    ? configJson["map"]["chunks"]["residentRadius"].asInt()
+    : gameSize * 4;
+  // Chunks the camera will reach within this many milliseconds at its current speed are generated ahead of time
+  prefetchMs = configJson["map"]["chunks"].get("prefetchMs", 1500).asInt();
+  // Chunk data beyond this many megabytes is evicted to disk, least recently used first; 0 keeps everything
+  memoryBudgetMB = configJson["map"]["chunks"].get("memoryBudgetMB", 0).asInt();
+  chunkStorePath = configJson["map"]["chunks"].get("storePath", "chunks").asString();
+  // Generated chunks are saved here on exit and loaded back before generating over them; empty turns this off
+  worldPath = configJson["map"]["chunks"].get("worldPath", "world").asString();
+  // Chunks are generated from this and their coordinates; 0 picks one, and a saved world keeps its own
+  worldSeed = configJson["map"].get("seed", 0).asUInt64();
+
+  // Ids follow declaration order, so cross-references resolve before their targets are parsed
+  std::vector<Json::ArrayIndex> terrainEntries, biomeEntries, objectEntries, mobEntries;
+  terrainTypeIds = internTypeNames("terrains", terrainTypesById, terrainEntries);
+  biomeTypeIds = internTypeNames("biomes", biomeTypesById, biomeEntries);
+  objectTypeIds = internTypeNames("objects", objectTypesById, objectEntries);
+  mobTypeIds = internTypeNames("mobs", mobTypesById, mobEntries);
 
   ////////////////
   //  TERRAINS
   ///////////////
-  for (auto i = 0; i < configJson["terrains"].size(); ++i)
+  for (auto id = 0; id < terrainTypesById.size(); ++id)
   {
+    auto i = terrainEntries[id];
     animationMap aMap = configureAnimationMap(i, "terrains");
     std::string tileTypeName = configJson["terrains"][i]["name"].asString();
     bool impassable = configJson["terrains"][i]["impassable"].asBool();
     bool clusters = configJson["terrains"][i]["clusters"].asBool();
     float multiplier = configJson["terrains"][i]["multiplier"].asFloat();
     float objectFrequencyMultiplier = configJson["terrains"][i]["objectFrequencyMultiplier"].asFloat();
-    std::vector<std::string> relatedObjectTypes;
-    std::vector<std::string> relatedObjectTypeProbabilities;
+    std::vector<TypeId> relatedObjectTypes;
+    WeightedTypes relatedObjectTypeWeights;
     const Json::Value& relatedObjectsArray = configJson["terrains"][i]["objects"];
     for (int i = 0; i < relatedObjectsArray.size(); i++)
     {
       if (relatedObjectsArray[i].isString())
       {
-        relatedObjectTypes.push_back(relatedObjectsArray[i].asString());
-        for (auto a = 0; a < 10; a++)
-          relatedObjectTypeProbabilities.push_back(relatedObjectsArray[i].asString());
+        TypeId objectTypeId = getTypeId(objectTypeIds, relatedObjectsArray[i].asString());
+        if (objectTypeId == NO_TYPE)
+          continue;
+        relatedObjectTypes.push_back(objectTypeId);
+        relatedObjectTypeWeights.add(objectTypeId, 1);
       }
       else if (relatedObjectsArray[i].isObject())
       {
-        std::string objectTypeName = relatedObjectsArray[i]["type"].asString();
+        TypeId objectTypeId = getTypeId(objectTypeIds, relatedObjectsArray[i]["type"].asString());
         float objectTypeNameFrequency = relatedObjectsArray[i]["multiplier"].asFloat();
-        relatedObjectTypes.push_back(objectTypeName);
-        for (auto a = 0; a < 10 * objectTypeNameFrequency; a++)
-          relatedObjectTypeProbabilities.push_back(objectTypeName);
+        if (objectTypeId == NO_TYPE)
+          continue;
+        relatedObjectTypes.push_back(objectTypeId);
+        relatedObjectTypeWeights.add(objectTypeId, objectTypeNameFrequency);
       }
     }
+    relatedObjectTypeWeights.build();
     TileType tileType { tileTypeName };
     TerrainType terrainType {
       tileTypeName,
       relatedObjectTypes,
       objectFrequencyMultiplier,
-      relatedObjectTypeProbabilities,
+      relatedObjectTypeWeights,
       impassable,
       multiplier,
       clusters
     };
+    terrainType.id = static_cast<TypeId>(id);
     terrainType.animationMap = aMap;
-    if (aMap[tileObject::DOWN].size() > 1)
-    {
-      terrainType.animationSpeed = 1000;
-    }
+    terrainType.animationSpeed = aMap[tileObject::DOWN].size() > 1 ? 1000 : 0;
     tileTypes[tileType.name] = tileType;
     terrainTypes[terrainType.name] = terrainType;
+    terrainTypesById[terrainType.id] = &terrainTypes[terrainType.name];
     terrainTypesKeys.push_back(terrainType.name);
     SDL_Log("- Loaded '%s' terrain", tileTypeName.c_str());
   }
@@ -109,10 +171,12 @@ ConfigurationController::ConfigurationController (std::string configFilePath, st
   ////////////////
   //  BIOMES
   ///////////////
-  for (auto i = 0; i < configJson["biomes"].size(); ++i)
+  for (auto id = 0; id < biomeTypesById.size(); ++id)
   {
+    auto i = biomeEntries[id];
     BiomeType b;
 
+    b.id = static_cast<TypeId>(id);
     b.name = configJson["biomes"][i]["name"].asString();
     b.maxDepth = configJson["biomes"][i]["maxDepth"].asInt();
     b.minDepth = configJson["biomes"][i]["minDepth"].asInt();
@@ -127,36 +191,49 @@ ConfigurationController::ConfigurationController (std::string configFilePath, st
       auto m = t["multiplier"].asFloat();
       if (m <= 0)
         m = 1;
-      b.terrainTypes[b.terrainTypes.size()] = { t["name"].asString(), m };
-      for (int i = 0; i < 10 * m; i++)
-        b.terrainTypeProbabilities.push_back(t["name"].asString());
+      TypeId terrainTypeId = getTypeId(terrainTypeIds, t["name"].asString());
+      if (terrainTypeId == NO_TYPE)
+        continue;
+      b.terrainTypes.push_back({ terrainTypeId, m });
+      b.terrainTypeWeights.add(terrainTypeId, m);
     }
+    b.terrainTypeWeights.build();
     biomeTypes[b.name] = b;
+    biomeTypesById[b.id] = &biomeTypes[b.name];
 
-    for (auto i = b.maxDepth; i >= b.minDepth; i--)
+    if (b.maxDepth >= static_cast<int>(biomeLevelMap.size()))
+    {
+      biomeLevelMap.resize(b.maxDepth + 1);
+      biomeTypeWeights.resize(b.maxDepth + 1);
+    }
+    for (auto i = b.maxDepth; i >= b.minDepth && i >= 0; i--)
     {
-      biomeLevelMap[i][b.name] = &biomeTypes[b.name];
-      for (int j = 0; j < 10 * b.multiplier; j++)
-        biomeTypeProbabilities[i].push_back(b.name);
+      biomeLevelMap[i][b.id] = true;
+      biomeTypeWeights[i].add(b.id, b.multiplier);
     }
 
     biomeTypeKeys.push_back(b.name);
     SDL_Log("- Loaded '%s' biome", b.name.c_str());
   }
+  for (auto& w : biomeTypeWeights)
+    w.build();
 
   ////////////////////
   //  WORLDOBJECTS
   ///////////////////
-  for (auto i = 0; i < configJson["objects"].size(); ++i)
+  for (auto id = 0; id < objectTypesById.size(); ++id)
   {
+    auto i = objectEntries[id];
     std::string objectTypeName = configJson["objects"][i]["name"].asString();
     bool impassable = configJson["objects"][i]["impassable"].asBool();
     bool clusters = configJson["objects"][i]["clusters"].asBool();
     const Json::Value& biomesArray = configJson["objects"][i]["biomes"];
-    std::map<std::string, int> bM;
+    std::bitset<MAX_TYPE_IDS> bM;
     for (int i = 0; i < biomesArray.size(); i++)
     {
-      bM[biomesArray[i].asString()] = 1;
+      TypeId biomeTypeId = getTypeId(biomeTypeIds, biomesArray[i].asString());
+      if (biomeTypeId != NO_TYPE)
+        bM[biomeTypeId] = true;
     }
 
     animationMap aMap = configureAnimationMap(i, "objects");;
@@ -169,21 +246,26 @@ ConfigurationController::ConfigurationController (std::string configFilePath, st
       1000,
       bM
     );
+    o.id = static_cast<TypeId>(id);
     objectTypes[objectTypeName] = o;
+    objectTypesById[o.id] = &objectTypes[objectTypeName];
     SDL_Log("- Loaded '%s' object", objectTypeName.c_str());
   }
 
   ////////////////
   //  MOBS
   ///////////////
-  for (auto i = 0; i < configJson["mobs"].size(); ++i)
+  for (auto id = 0; id < mobTypesById.size(); ++id)
   {
+    auto i = mobEntries[id];
     std::string mobTypeName = configJson["mobs"][i]["name"].asString();
     const Json::Value& biomesArray = configJson["mobs"][i]["biomes"];
-    std::map<std::string, int> bM;
+    std::bitset<MAX_TYPE_IDS> bM;
     for (int i = 0; i < biomesArray.size(); i++)
     {
-      bM[biomesArray[i].asString()] = 1;
+      TypeId biomeTypeId = getTypeId(biomeTypeIds, biomesArray[i].asString());
+      if (biomeTypeId != NO_TYPE)
+        bM[biomeTypeId] = true;
     }
     SDL_Log("- Loaded '%s' mob", mobTypeName.c_str());
     animationMap aMap = configureAnimationMap(i, "mobs");
@@ -196,6 +278,8 @@ ConfigurationController::ConfigurationController (std::string configFilePath, st
       1000,
       bM
     };
+    mobType.id = static_cast<TypeId>(id);
     mobTypes[mobType.name] = mobType;
+    mobTypesById[mobType.id] = &mobTypes[mobType.name];
   };
 }
\ No newline at end of file
@@ -19,6 +19,7 @@ int GameEngine::init()
   registerController<controller::RenderController>(renderController);
   registerController<controller::GraphicsController>(graphicsController);
   registerController<controller::UIController>(uiController);
+  startTicks = SDL_GetTicks();
 
   std::srand(std::time(nullptr));
   if (!tileSize)
@@ -109,17 +110,23 @@ int GameEngine::init()
     zMaxLevel, mobTypes, objectTypes, biomeTypes, biomeTypeKeys, terrainTypes, tileTypes, &configController
   );
 
-  // Create default tilemap
+  // Create default tilemap: the chunk under the camera now, so there is something to show, and the rest in the
+  // background from the camera outwards
   SDL_Log("Generating default tilemap...");
+  auto& cameraRect = engine::controller<controller::GraphicsController>.camera;
+  auto view = engine::controller<controller::CameraController>.predictView(0);
+  mapController.focusGeneration(cameraRect.x, cameraRect.y, &view);
+  Rect cameraChunk = { cameraRect.x, cameraRect.y, cameraRect.x, cameraRect.y };
+  mapController.generateMapChunk(&cameraChunk);
   Rect initialChunk = { 0 - configController.gameSize, 0 - configController.gameSize, configController.gameSize, configController.gameSize };
-  mapController.generateMapChunk(&initialChunk);
+  initialWorld = mapController.requestChunks(&initialChunk);
   auto UI = &engine::controller<controller::UIController>;
   // UI->createUIWindow()
   //   ->setDimensions(30, 30, 125, 300)
   //   ->setTitle("Welcome!")
   //   ->setFont(gameFont) //
   //   ->addTextBox("This is a demo of `tile-project`.", 10, 10, 100, 200);
-  SDL_Log("Tilemap created.");
+  SDL_Log("Generating the rest of the tilemap in the background.");
   return 0;
 }
 
@@ -129,12 +136,34 @@ int GameEngine::run ()
   while (running)
   {
     controller<controller::EventsController>()->handleEvents();
+    auto view = engine::controller<controller::CameraController>.predictView(configController.prefetchMs);
+    mapController.focusGeneration(
+      engine::controller<controller::GraphicsController>.camera.x,
+      engine::controller<controller::GraphicsController>.camera.y,
+      &view
+    );
+    mapController.publishChunks();
     SDL_RenderClear(appRenderer);
     controller<controller::RenderController>()->renderCopyTiles();
     controller<controller::RenderController>()->renderCopyPlayer();
     engine::controller<controller::GraphicsController>.applyUI();
     engine::controller<controller::RenderController>.renderUI();
     SDL_RenderPresent(appRenderer);
+    if (firstFrame)
+    {
+      SDL_Log("First frame presented %u ms after startup.", SDL_GetTicks() - startTicks);
+      firstFrame = false;
+    }
+    if (initialWorld.valid() && initialWorld.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+      SDL_Log("Tilemap created %u ms after startup.", SDL_GetTicks() - startTicks);
+      initialWorld = std::shared_future<void>();
+    }
+    mapController.manageResidency(
+      engine::controller<controller::GraphicsController>.camera.x,
+      engine::controller<controller::GraphicsController>.camera.y
+    );
   }
+  mapController.saveWorld();
   return 1;
 }
\ No newline at end of file
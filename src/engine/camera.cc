@@ -17,17 +17,19 @@ void CameraController::scrollCamera(int directions)
     y++;
   if (directions & input::UP)
     y--;
-  if (e->mapController.isPassable({e->zLevel, x, y}))
+  if (e->mapController.isPassable({e->zLevel, x, y}, false))
   {
     if (e->tileSize > 8)
       engine::controller<controller::MovementController>.scrollGameSurface(directions);
     else
       SDL_Delay(15);
+    trackStep(x - engine::controller<controller::GraphicsController>.camera.x, y - engine::controller<controller::GraphicsController>.camera.y);
     engine::controller<controller::GraphicsController>.camera.x = x;
     engine::controller<controller::GraphicsController>.camera.y = y;
   }
   else
   {
+    trackStep(0, 0);
     e->controller<controller::RenderController>()->renderCopyTiles();
     e->controller<controller::RenderController>()->renderCopyPlayer();
     e->controller<controller::GraphicsController>()->applyUI();
@@ -36,6 +38,45 @@ void CameraController::scrollCamera(int directions)
   }
 }
 
+// Folds one step of (dx, dy) tiles into the velocity. A step after a long pause starts from rest rather than
+// averaging in the time spent standing still.
+void CameraController::trackStep(int dx, int dy)
+{
+  auto now = SDL_GetTicks();
+  auto elapsed = now - lastStep;
+  lastStep = now;
+  if (elapsed == 0 || elapsed > 500)
+  {
+    velocityX = 0;
+    velocityY = 0;
+    return;
+  }
+  velocityX = velocityX / 2 + dx * 500.0f / elapsed;
+  velocityY = velocityY / 2 + dy * 500.0f / elapsed;
+}
+
+// The tiles in view now together with those in view lookahead milliseconds from now, if the camera keeps going
+// as it has been. Sized from the window grid, as iterateOverTilesInView is.
+Rect CameraController::predictView(int lookahead)
+{
+  auto [_w, _h] = engine::graphics::controller<engine::graphics::WindowController>.getWindowGridDimensions();
+  int x = engine::controller<controller::GraphicsController>.camera.x;
+  int y = engine::controller<controller::GraphicsController>.camera.y;
+  int dx = 0;
+  int dy = 0;
+  if (SDL_GetTicks() - lastStep <= 500)
+  {
+    dx = static_cast<int>(std::lround(velocityX * lookahead / 1000.0f));
+    dy = static_cast<int>(std::lround(velocityY * lookahead / 1000.0f));
+  }
+  return {
+    std::min(x, x + dx) - _w/2,
+    std::min(y, y + dy) - _h/2,
+    std::max(x, x + dx) + _w/2 + 5,
+    std::max(y, y + dy) + _h/2 + 5
+  };
+}
+
 void CameraController::iterateOverTilesInView (std::function<void(std::tuple<int, int, int, int>)> f)
 {
   auto [_w, _h] = engine::graphics::controller<engine::graphics::WindowController>.getWindowGridDimensions();
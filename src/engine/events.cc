@@ -13,9 +13,9 @@ void EventsController::handleEvents()
         e->stopRunning();
       }
       std::thread graphicalThread([](int d) { engine::controller<controller::CameraController>.scrollCamera(d); }, directions);
-      std::thread mapProcessingThread([](int d) { engine::controller<controller::MovementController>.processMap(d); }, directions);
-      mapProcessingThread.detach();
       graphicalThread.join();
+      // Only queues generation, which runs in the background; after the step so it sees the camera's new velocity
+      engine::controller<controller::MovementController>.processMap();
     };
     e->userInputHandler.handleKeyboardMovement(keyboardMovementHandler);
     auto eventHandler = [this](SDL_Event* event)
@@ -27,7 +27,7 @@ void EventsController::handleEvents()
       }
       else if (event->type == SDL_KEYDOWN)
       {
-        auto t = &e->mapController.terrainMap[e->zLevel][{engine::controller<controller::GraphicsController>.camera.x, engine::controller<controller::GraphicsController>.camera.y}];
+        auto t = e->mapController.findTerrain(e->zLevel, engine::controller<controller::GraphicsController>.camera.x, engine::controller<controller::GraphicsController>.camera.y);
         std::string objs;
         switch(event->key.keysym.sym)
         {
@@ -43,15 +43,17 @@ void EventsController::handleEvents()
             // }
             break;
           case SDLK_SPACE:
+            if (t == nullptr)
+              break;
             SDL_Log(
               "\nCamera: %dx%dx%dx%d\nCurrent terrain type: %s\nCurrent biome type: %s\nCurrent terrain type sprite name: %s\nInitialized: %d",
               engine::controller<controller::GraphicsController>.camera.x,
               engine::controller<controller::GraphicsController>.camera.y,
               engine::controller<controller::GraphicsController>.camera.w,
               engine::controller<controller::GraphicsController>.camera.h,
-              t->terrainType->name.c_str(),
-              t->biomeType->name.c_str(),
-              t->terrainType->getFrame(0)->name.c_str(),
+              e->configController.getTerrainType(t->terrainId)->name.c_str(),
+              e->configController.getBiomeType(t->biomeId)->name.c_str(),
+              e->configController.getTerrainType(t->terrainId)->getFrame(0)->name.c_str(),
               t->initialized
             );
             break;
@@ -63,7 +65,7 @@ void EventsController::handleEvents()
             }
             break;
           case SDLK_q:
-            if (std::abs(e->zLevel) < static_cast <int>(e->mapController.terrainMap.size()))
+            if (std::abs(e->zLevel) < e->mapController.maxDepth)
             {
               if (e->zLevel < e->zMaxLevel - 1)
               {
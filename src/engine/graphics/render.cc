@@ -40,7 +40,7 @@ int RenderController::renderCopySprite(std::string spriteName, int x, int y)
     return -1;
 }
 
-int RenderController::renderCopyObject(std::shared_ptr<WorldObject> t, int x, int y)
+int RenderController::renderCopyObject(WorldObject* t, int x, int y)
 {
   if (!t->isAnimated())
     return renderCopySprite(t->objectType->getFrame(0), x, y);
@@ -62,7 +62,7 @@ int RenderController::renderCopyObject(std::shared_ptr<WorldObject> t, int x, in
   }
 }
 
-int RenderController::renderCopyMobObject(std::shared_ptr<MobObject> t, int x, int y)
+int RenderController::renderCopyMobObject(MobObject* t, int x, int y)
 {
   int o_x, o_y = 0;
   if (t->relativeX != 0 || t->relativeY != 0)
@@ -94,27 +94,36 @@ int RenderController::renderCopyMobObject(std::shared_ptr<MobObject> t, int x, i
   }
 }
 
-int RenderController::renderCopyTerrain(TerrainObject* t, int x, int y) {
-  if (!t->isAnimated())
-    return renderCopySprite(t->terrainType->getFrame(0), x, y);
+int RenderController::renderCopyTerrain(const TerrainObject* t, int x, int y, int i, int j) {
+  auto terrainType = e->configController.getTerrainType(t->terrainId);
+  if (!terrainType->isAnimated())
+    return renderCopySprite(terrainType->getFrame(0), x, y);
   else
   {
-    if (t->animationTimer.elapsed() > t->animationSpeed)
-    {
-      t->animationTimer.stop();
-      t->animationTimer.start();
-      t->animationFrame++;
-      if (t->animationFrame >= t->terrainType->maxFrames())
-        t->animationFrame = 0;
-    }
-    auto it = t->terrainType->animationMap[t->direction].find(t->animationFrame);
-    if (it == t->terrainType->animationMap[t->direction].end())
-      return renderCopySprite(t->terrainType->getFrame(0), x, y);
+    int frame = terrainType->getAnimationFrame(SDL_GetTicks(), TerrainObject::hashPosition(e->zLevel, i, j));
+    auto it = terrainType->animationMap[tileObject::DOWN].find(frame);
+    if (it == terrainType->animationMap[tileObject::DOWN].end())
+      return renderCopySprite(terrainType->getFrame(0), x, y);
     else
       return renderCopySprite(it->second, x, y);
   }
 }
 
+// Stands in for a tile whose chunk isn't generated or loaded yet; chunks alternate shades so they read as blocks
+int RenderController::renderFillPlaceholder(int x, int y, int i, int j)
+{
+  int tS = e->getTileSize();
+  SDL_Rect dest {x*tS, y*tS, tS, tS};
+  auto shade = ((map::chunk::toChunkCoordinate(i) + map::chunk::toChunkCoordinate(j)) & 1) ? 48 : 32;
+  SDL_SetRenderDrawColor(e->appRenderer, shade, shade, shade, 255);
+  if (SDL_RenderFillRect(e->appRenderer, &dest) < 0)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't fill placeholder tile: %s", SDL_GetError());
+    return 3;
+  }
+  return 0;
+}
+
 int RenderController::renderFillUIWindow(UIRect* window)
 {
   SDL_Rect shadow {window->x, window->y, window->w, window->h+5};
@@ -2,39 +2,17 @@
 #include "engine/graphics.h"
 #include "engine/render.h"
 #include "engine/movement.h"
+#include "engine/camera.h"
 
 using namespace controller;
 
-void MovementController::processMap(int directions)
+// Queues whatever the camera will see within the prefetch lookahead, so it is generated before it scrolls into view
+void MovementController::processMap()
 {
-  auto [_w, _h] = engine::graphics::controller<engine::graphics::WindowController>.getWindowGridDimensions();
-  SDL_Point checkCoordinates = { engine::controller<controller::GraphicsController>.camera.x, engine::controller<controller::GraphicsController>.camera.y };
-  Rect chunkRect = {
-    engine::controller<controller::GraphicsController>.camera.x-e->configController.gameSize*2,
-    engine::controller<controller::GraphicsController>.camera.y-e->configController.gameSize*2,
-    engine::controller<controller::GraphicsController>.camera.x+e->configController.gameSize*2,
-    engine::controller<controller::GraphicsController>.camera.y+e->configController.gameSize*2
-  };
-  if (directions & input::RIGHT)
-    checkCoordinates.x += _w;
-    chunkRect.x1 += _w/2;
-  if (directions & input::LEFT)
-    checkCoordinates.x -= _w;
-    chunkRect.x1 -= _w/2;
-  if (directions & input::UP)
-    checkCoordinates.y -= _h;
-    chunkRect.y1 += _h/2;
-  if (directions & input::DOWN)
-    checkCoordinates.y += _h;
-    chunkRect.y1 -= _h/2;
-  auto it = e->mapController.terrainMap[e->zLevel].find({ checkCoordinates.x, checkCoordinates.y });
-  if (it == e->mapController.terrainMap[e->zLevel].end())
-  {
-    SDL_Log("Detected ungenerated map: %d %d", checkCoordinates.x, checkCoordinates.y);
-    e->mapController.generateMapChunk(&chunkRect);
-  }
-
-};
+  auto view = engine::controller<controller::CameraController>.predictView(e->configController.prefetchMs);
+  // Behind the initial world, which is requested at priority 0
+  e->mapController.requestChunks(&view, 1);
+}
 
 void MovementController::scrollGameSurface(int directions)
 {
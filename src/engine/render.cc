@@ -7,31 +7,27 @@ using namespace controller;
 
 void RenderController::renderCopyTiles()
 {
-  auto processor = [this](std::tuple<int, int, int, int> locationData){
+  auto view = e->mapController.snapshot();
+  auto processor = [this, &view](std::tuple<int, int, int, int> locationData){
     auto [x, y, i, j] = locationData;
-    auto it = e->mapController.mobMap[e->zLevel][{i, j}].begin();
-    while (it != e->mapController.mobMap[e->zLevel][{i, j}].end())
+    view.forEachMob(e->zLevel, i, j, [this, i, j](objects::Handle handle, MobObject* mob)
     {
-      auto mob = it->get();
-      for (auto s : mob->simulators)
-        s->simulate();
-      auto orders = it->get()->orders;
-      if (orders & simulated::MOVE)
+      for (auto& s : mob->simulators)
+        s.simulate();
+      if (mob->orders & simulated::MOVE)
       {
         mob->orders -= simulated::MOVE;
-        if (!e->mapController.isPassable(std::make_tuple(mob->z,mob->x,mob->y)))
-          continue;
+        if (!e->mapController.isPassable(std::make_tuple(mob->z,mob->x,mob->y), false))
+          return;
         auto direction = i != mob->x
           ? (i < mob->x ? tileObject::RIGHT : tileObject::LEFT)
           : j != mob->y
             ? (j < mob->y ? tileObject::DOWN : tileObject::UP)
             : tileObject::DOWN;
 
-        it = e->mapController.moveMob(it, {e->zLevel, i, j}, direction);
-        continue;
+        e->mapController.moveMob(handle, {e->zLevel, i, j}, direction);
       }
-      ++it;
-    }
+    });
   };
   std::thread p (
     [this](std::function<void(std::tuple<int, int, int, int>)> f)
@@ -39,27 +35,23 @@ void RenderController::renderCopyTiles()
       e->controller<controller::CameraController>()->iterateOverTilesInView(f);
     }, processor
   );
-  std::vector<std::pair<std::shared_ptr<MobObject>, std::tuple<int, int>>> movers;
-  auto terrainRenderer = [this,&movers](std::tuple<int, int, int, int> locationData){
+  std::vector<std::pair<MobObject*, std::tuple<int, int>>> movers;
+  auto terrainRenderer = [this,&view,&movers](std::tuple<int, int, int, int> locationData){
     auto [x, y, i, j] = locationData;
-    auto terrainObject = e->mapController.terrainMap[e->zLevel].find({ i, j });
-    if (terrainObject != e->mapController.terrainMap[e->zLevel].end())
-      engine::graphics::controller<engine::graphics::RenderController>.renderCopyTerrain(&terrainObject->second, x, y);
-    else {}
-      //engine::graphics::controller<engine::graphics::RenderController>.renderCopySprite("Sprite 0x128", x, y);
-    auto worldObject = e->mapController.worldMap[e->zLevel].find({ i, j });
-    if (worldObject != e->mapController.worldMap[e->zLevel].end())
-      for ( auto w : worldObject->second )
-        engine::graphics::controller<engine::graphics::RenderController>.renderCopyObject(w, x, y);
-    auto mobObject = e->mapController.mobMap[e->zLevel].find({ i, j });
-    if (mobObject != e->mapController.mobMap[e->zLevel].end())
-      for ( auto &w : mobObject->second )
-      {
-        if (w->relativeX == 0 && w->relativeY == 0)
-          engine::graphics::controller<engine::graphics::RenderController>.renderCopyMobObject(w, x, y);
-        else
-          movers.push_back({w, { x, y }});
-      }
+    auto terrainObject = view.findTerrain(e->zLevel, i, j);
+    if (terrainObject != nullptr)
+      engine::graphics::controller<engine::graphics::RenderController>.renderCopyTerrain(terrainObject, x, y, i, j);
+    else
+      engine::graphics::controller<engine::graphics::RenderController>.renderFillPlaceholder(x, y, i, j);
+    view.forEachObject(e->zLevel, i, j, [x, y](objects::Handle h, WorldObject* w) {
+      engine::graphics::controller<engine::graphics::RenderController>.renderCopyObject(w, x, y);
+    });
+    view.forEachMob(e->zLevel, i, j, [x, y, &movers](objects::Handle h, MobObject* w) {
+      if (w->relativeX == 0 && w->relativeY == 0)
+        engine::graphics::controller<engine::graphics::RenderController>.renderCopyMobObject(w, x, y);
+      else
+        movers.push_back({w, { x, y }});
+    });
   };
   std::thread r (
     [&movers](std::function<void(std::tuple<int, int, int, int>)> f1)
@@ -0,0 +1,104 @@
+#include "executor.h"
+
+using namespace executor;
+
+namespace
+{
+  thread_local Executor* currentExecutor = nullptr;
+  thread_local int currentWorker = -1;
+}
+
+Executor::Executor (std::size_t n) : queued(0), nextWorker(0), stopping(false)
+{
+  n = std::max<std::size_t>(n, 1);
+  for (std::size_t i = 0; i < n; i++)
+    workers.push_back(std::make_unique<Worker>());
+  for (std::size_t i = 0; i < n; i++)
+    threads.emplace_back(&Executor::work, this, static_cast<int>(i));
+}
+
+Executor::~Executor ()
+{
+  {
+    std::unique_lock lock(sleepMtx);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& t : threads)
+    t.join();
+}
+
+int Executor::self ()
+{
+  return currentExecutor == this ? currentWorker : -1;
+}
+
+void Executor::submit (Task task)
+{
+  auto i = self();
+  if (i < 0)
+    i = nextWorker++ % workers.size();
+  // Bumped before the task is visible, so the runOne that takes it can't decrement first and wrap; and under
+  // sleepMtx, so a worker checking whether to sleep can't miss it
+  {
+    std::unique_lock lock(sleepMtx);
+    queued++;
+  }
+  {
+    std::unique_lock lock(workers[i]->workerMtx);
+    workers[i]->tasks.push_back(std::move(task));
+  }
+  wake.notify_one();
+}
+
+bool Executor::runOne ()
+{
+  int i = self();
+  Task task;
+  if (i >= 0)
+  {
+    std::unique_lock lock(workers[i]->workerMtx);
+    if (workers[i]->tasks.size())
+    {
+      task = std::move(workers[i]->tasks.back());
+      workers[i]->tasks.pop_back();
+    }
+  }
+  auto start = i >= 0 ? i + 1 : nextWorker.load();
+  for (std::size_t n = 0; !task && n < workers.size(); n++)
+  {
+    auto& victim = *workers[(start + n) % workers.size()];
+    std::unique_lock lock(victim.workerMtx);
+    if (victim.tasks.size())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+    }
+  }
+  if (!task)
+    return false;
+  queued--;
+  task();
+  return true;
+}
+
+void Executor::work (int i)
+{
+  currentExecutor = this;
+  currentWorker = i;
+  while (true)
+  {
+    if (runOne())
+      continue;
+    std::unique_lock lock(sleepMtx);
+    wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+    if (stopping)
+      return;
+  }
+}
+
+Executor& executor::shared ()
+{
+  static Executor pool (std::max(2u, std::thread::hardware_concurrency()) - 1);
+  return pool;
+}
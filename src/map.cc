@@ -4,4 +4,5 @@
 #include "map/mob.h"
 #include "map/processors.h"
 #include "map/generators.h"
+#include "map/persistence.h"
 #include "map/chunk/chunk.h"
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "map/chunk/region.h"
+#include <atomic>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace map::chunk;
+
+namespace
+{
+  bool writeAll (int fd, const void* p, std::size_t n, off_t offset)
+  {
+    auto b = static_cast<const std::uint8_t*>(p);
+    while (n > 0)
+    {
+      auto written = ::pwrite(fd, b, n, offset);
+      if (written <= 0)
+        return false;
+      b += written;
+      n -= written;
+      offset += written;
+    }
+    return true;
+  }
+
+  std::size_t roundToPage (std::size_t n) { return (n + REGION_PAGE - 1) / REGION_PAGE * REGION_PAGE; }
+}
+
+RegionFile::~RegionFile ()
+{
+  if (data != nullptr)
+    ::munmap(data, mapped);
+  if (fd >= 0)
+    ::close(fd);
+}
+
+std::unique_ptr<RegionFile> RegionFile::open (const std::filesystem::path& path, int z, int rx, int ry)
+{
+  auto r = std::make_unique<RegionFile>();
+  r->fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (r->fd < 0 || ::fstat(r->fd, &st) != 0)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open region file %s", path.c_str());
+    return nullptr;
+  }
+  r->size = st.st_size;
+  if (r->size == 0)
+  {
+    std::vector<std::uint8_t> page (REGION_PAGE, 0);
+    RegionHeader h {};
+    h.magic = REGION_MAGIC;
+    h.version = REGION_VERSION;
+    h.z = z;
+    h.rx = rx;
+    h.ry = ry;
+    h.chunkSize = CHUNK_SIZE;
+    h.regionSize = REGION_SIZE;
+    std::memcpy(page.data(), &h, sizeof(h));
+    if (!writeAll(r->fd, page.data(), page.size(), 0) || ::fdatasync(r->fd) != 0)
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create region file %s", path.c_str());
+      return nullptr;
+    }
+    r->size = REGION_PAGE;
+  }
+  if (r->size < REGION_PAGE || r->size % REGION_PAGE != 0 || !r->remap())
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Region file %s is truncated or could not be mapped", path.c_str());
+    return nullptr;
+  }
+  auto h = r->header();
+  if (h->magic != REGION_MAGIC || h->version != REGION_VERSION || h->z != z || h->rx != rx || h->ry != ry
+    || h->chunkSize != CHUNK_SIZE || h->regionSize != REGION_SIZE)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Region file %s is from another version or region; ignoring it", path.c_str());
+    return nullptr;
+  }
+  return r;
+}
+
+bool RegionFile::remap ()
+{
+  if (data != nullptr)
+    ::munmap(data, mapped);
+  auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    data = nullptr;
+    mapped = 0;
+    return false;
+  }
+  data = static_cast<std::uint8_t*>(p);
+  mapped = size;
+  return true;
+}
+
+const std::uint8_t* RegionFile::read (int index, std::size_t& length)
+{
+  if (data == nullptr)
+    return nullptr;
+  auto entry = std::atomic_ref<std::uint64_t>(header()->table[index]).load(std::memory_order_acquire);
+  if (entry == 0)
+    return nullptr;
+  std::size_t offset = (entry >> 32) * REGION_PAGE;
+  std::size_t total = entry & 0xFFFFFFFF;
+  PayloadHeader h;
+  if (total < sizeof(h) || offset + total > mapped)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Region entry %d points outside its file", index);
+    return nullptr;
+  }
+  std::memcpy(&h, data + offset, sizeof(h));
+  auto body = data + offset + sizeof(h);
+  if (h.magic != PAYLOAD_MAGIC || h.version != REGION_VERSION || h.length != total - sizeof(h)
+    || checksum(body, h.length) != h.checksum)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Region entry %d failed its checksum", index);
+    return nullptr;
+  }
+  length = h.length;
+  return body;
+}
+
+bool RegionFile::write (const std::vector<std::pair<int, std::vector<std::uint8_t>>>& payloads)
+{
+  std::vector<std::pair<int, std::uint64_t>> entries;
+  entries.reserve(payloads.size());
+  for (auto& [index, body] : payloads)
+  {
+    PayloadHeader h { PAYLOAD_MAGIC, REGION_VERSION, static_cast<std::uint32_t>(body.size()), checksum(body.data(), body.size()) };
+    if (!writeAll(fd, &h, sizeof(h), size) || !writeAll(fd, body.data(), body.size(), size + sizeof(h)))
+      return false;
+    entries.push_back({ index, static_cast<std::uint64_t>(size / REGION_PAGE) << 32 | (sizeof(h) + body.size()) });
+    size += roundToPage(sizeof(h) + body.size());
+  }
+  // Payloads have to be on disk before any entry points at them
+  if (::ftruncate(fd, size) != 0 || ::fdatasync(fd) != 0 || !remap())
+    return false;
+  for (auto& [index, entry] : entries)
+    std::atomic_ref<std::uint64_t>(header()->table[index]).store(entry, std::memory_order_release);
+  return ::msync(data, REGION_PAGE, MS_SYNC) == 0;
+}
+
+void RegionStore::open (const std::filesystem::path& p)
+{
+  std::unique_lock lock(regionMtx);
+  regions.clear();
+  path = p;
+  if (path.empty())
+    return;
+  std::error_code ec;
+  std::filesystem::create_directories(path, ec);
+  if (ec)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create world directory %s; the map will not be saved", path.c_str());
+    path.clear();
+  }
+}
+
+std::uint64_t RegionStore::seed (std::uint64_t fallback)
+{
+  std::unique_lock lock(regionMtx);
+  if (path.empty())
+    return fallback;
+  std::uint64_t s;
+  std::ifstream in (path / "seed");
+  if (in >> s)
+    return s;
+  std::ofstream out (path / "seed", std::ios::trunc);
+  if (!(out << fallback << std::endl))
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not record the world seed in %s", path.c_str());
+  return fallback;
+}
+
+RegionFile* RegionStore::region (int z, int cx, int cy, bool create)
+{
+  int rx = cx >> REGION_SHIFT;
+  int ry = cy >> REGION_SHIFT;
+  auto k = static_cast<std::uint64_t>(static_cast<std::uint16_t>(z)) << 48
+    | static_cast<std::uint64_t>(static_cast<std::uint32_t>(rx) & 0xFFFFFF) << 24
+    | (static_cast<std::uint32_t>(ry) & 0xFFFFFF);
+  auto it = regions.find(k);
+  if (it != regions.end() && (it->second != nullptr || !create))
+    return it->second.get();
+  auto file = path / (std::to_string(z) + "." + std::to_string(rx) + "." + std::to_string(ry) + ".region");
+  std::error_code ec;
+  std::unique_ptr<RegionFile> r;
+  if (create || std::filesystem::exists(file, ec))
+    r = RegionFile::open(file, z, rx, ry);
+  return (regions[k] = std::move(r)).get();
+}
+
+std::size_t RegionStore::write (std::vector<Payload> payloads)
+{
+  std::unique_lock lock(regionMtx);
+  if (path.empty())
+    return 0;
+  std::map<RegionFile*, std::vector<std::pair<int, std::vector<std::uint8_t>>>> batches;
+  for (auto& p : payloads)
+    if (auto r = region(p.z, p.cx, p.cy, true))
+      batches[r].push_back({ index(p.cx, p.cy), std::move(p.bytes) });
+  std::size_t written = 0;
+  for (auto& [r, batch] : batches)
+  {
+    if (r->write(batch))
+      written += batch.size();
+    else
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not write %lu chunks to a region file in %s", batch.size(), path.c_str());
+  }
+  return written;
+}
@@ -0,0 +1,547 @@
+#include "map/chunk/store.h"
+#include "uuid.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+using namespace map::chunk;
+
+std::unique_ptr<PackedChunk> PackedChunk::pack (const Chunk& c)
+{
+  auto p = std::make_unique<PackedChunk>();
+  p->z = c.z;
+  p->cx = c.cx;
+  p->cy = c.cy;
+  p->generatedCount = c.generated.count();
+  p->histogram = c.histogram;
+  p->lastAccess = c.lastAccess.load(std::memory_order_relaxed);
+  p->dirty = c.dirty;
+  p->delta = c.delta;
+  p->version = c.journal.version;
+  std::array<std::uint16_t, CHUNK_AREA> cells;
+  for (auto i = 0; i < CHUNK_AREA; i++)
+  {
+    Cell cell { c.terrain[i], c.generated[i], c.passable[i] };
+    std::size_t n = 0;
+    while (n < p->palette.size() && !(p->palette[n] == cell))
+      n++;
+    if (n == p->palette.size())
+    {
+      if (n == MAX_PALETTE)
+        return nullptr;
+      p->palette.push_back(cell);
+    }
+    cells[i] = static_cast<std::uint16_t>(n);
+    if (c.objects[i] != objects::NO_HANDLE)
+      p->objects.push_back({ static_cast<std::uint16_t>(i), c.objects[i] });
+    if (c.mobs[i] != objects::NO_HANDLE)
+      p->mobs.push_back({ static_cast<std::uint16_t>(i), c.mobs[i] });
+  }
+
+  // Index widths divide 32 so no index straddles two words
+  int bits = 1;
+  while ((std::size_t(1) << bits) < p->palette.size())
+    bits *= 2;
+  std::size_t packedWords = CHUNK_AREA * bits / 32;
+  std::size_t runs = 1;
+  for (auto i = 1; i < CHUNK_AREA; i++)
+    if (cells[i] != cells[i - 1])
+      runs++;
+
+  if (runs <= packedWords)
+  {
+    p->bits = 0;
+    p->indices.reserve(runs);
+    std::uint32_t length = 1;
+    for (auto i = 1; i <= CHUNK_AREA; i++)
+    {
+      if (i < CHUNK_AREA && cells[i] == cells[i - 1])
+      {
+        length++;
+        continue;
+      }
+      p->indices.push_back(length << 16 | cells[i - 1]);
+      length = 1;
+    }
+  }
+  else
+  {
+    p->bits = bits;
+    p->indices.assign(packedWords, 0);
+    int perWord = 32 / bits;
+    for (auto i = 0; i < CHUNK_AREA; i++)
+      p->indices[i / perWord] |= static_cast<std::uint32_t>(cells[i]) << ((i % perWord) * bits);
+  }
+  p->palette.shrink_to_fit();
+  p->objects.shrink_to_fit();
+  p->mobs.shrink_to_fit();
+  return p;
+}
+
+std::unique_ptr<Chunk> PackedChunk::unpack () const
+{
+  auto c = std::make_unique<Chunk>(z, cx, cy);
+  c->lastAccess = lastAccess;
+  c->dirty = dirty;
+  c->delta = delta;
+  c->journal.restart(version);
+  c->histogram = histogram;
+  c->unpublished = true;
+  auto set = [&c, this](int i, std::uint32_t n)
+  {
+    auto& cell = palette[n];
+    c->terrain[i] = cell.terrain;
+    c->generated[i] = cell.generated;
+    c->passable[i] = cell.passable;
+  };
+  if (bits == 0)
+  {
+    int i = 0;
+    for (auto run : indices)
+      for (std::uint32_t n = 0; n < run >> 16; n++)
+        set(i++, run & 0xFFFF);
+  }
+  else
+  {
+    int perWord = 32 / bits;
+    std::uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+    for (auto i = 0; i < CHUNK_AREA; i++)
+      set(i, (indices[i / perWord] >> ((i % perWord) * bits)) & mask);
+  }
+  for (auto& [i, h] : objects)
+    c->objects[i] = h;
+  for (auto& [i, h] : mobs)
+    c->mobs[i] = h;
+  return c;
+}
+
+std::size_t PackedChunk::bytes () const
+{
+  return sizeof(PackedChunk)
+    + palette.capacity() * sizeof(Cell)
+    + indices.capacity() * sizeof(std::uint32_t)
+    + (objects.capacity() + mobs.capacity()) * sizeof(std::pair<std::uint16_t, objects::Handle>);
+}
+
+namespace
+{
+  const std::uint32_t CHUNK_FILE_MAGIC = 0x4B484354; // "TCHK"
+
+  template <typename T>
+  void put (std::ostream& out, const T& v) { out.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+  template <typename T>
+  bool get (std::istream& in, T& v) { return bool(in.read(reinterpret_cast<char*>(&v), sizeof(T))); }
+
+  template <typename T>
+  void putVector (std::ostream& out, const std::vector<T>& v)
+  {
+    put(out, static_cast<std::uint32_t>(v.size()));
+    out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+  }
+  template <typename T>
+  bool getVector (std::istream& in, std::vector<T>& v, std::uint32_t limit)
+  {
+    std::uint32_t n;
+    if (!get(in, n) || n > limit)
+      return false;
+    v.resize(n);
+    return bool(in.read(reinterpret_cast<char*>(v.data()), n * sizeof(T)));
+  }
+}
+
+// Written to a temporary name and renamed into place, so a reader never sees half a chunk
+bool PackedChunk::write (const std::filesystem::path& path) const
+{
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream out (tmp, std::ios::binary | std::ios::trunc);
+    put(out, CHUNK_FILE_MAGIC);
+    put(out, z);
+    put(out, cx);
+    put(out, cy);
+    put(out, bits);
+    put(out, static_cast<std::uint32_t>(generatedCount));
+    put(out, lastAccess);
+    put(out, dirty);
+    put(out, delta);
+    put(out, version);
+    put(out, static_cast<std::uint32_t>(palette.size()));
+    for (auto& cell : palette)
+    {
+      put(out, cell.terrain.biomeId);
+      put(out, cell.terrain.terrainId);
+      put(out, static_cast<std::uint8_t>(cell.terrain.initialized | cell.generated << 1 | cell.passable << 2));
+    }
+    putVector(out, histogram.terrain);
+    putVector(out, histogram.biome);
+    putVector(out, indices);
+    putVector(out, objects);
+    putVector(out, mobs);
+    if (!out.flush())
+      return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+std::unique_ptr<PackedChunk> PackedChunk::read (const std::filesystem::path& path)
+{
+  std::ifstream in (path, std::ios::binary);
+  auto p = std::make_unique<PackedChunk>();
+  std::uint32_t magic, generated, paletteSize;
+  if (!get(in, magic) || magic != CHUNK_FILE_MAGIC
+    || !get(in, p->z) || !get(in, p->cx) || !get(in, p->cy) || !get(in, p->bits)
+    || !get(in, generated) || !get(in, p->lastAccess) || !get(in, p->dirty) || !get(in, p->delta) || !get(in, p->version)
+    || !get(in, paletteSize) || paletteSize > MAX_PALETTE)
+    return nullptr;
+  p->generatedCount = generated;
+  p->palette.resize(paletteSize);
+  for (auto& cell : p->palette)
+  {
+    std::uint8_t flags;
+    if (!get(in, cell.terrain.biomeId) || !get(in, cell.terrain.terrainId) || !get(in, flags))
+      return nullptr;
+    cell.terrain.initialized = flags & 1;
+    cell.generated = flags & 2;
+    cell.passable = flags & 4;
+  }
+  if (!getVector(in, p->histogram.terrain, NO_TYPE) || !getVector(in, p->histogram.biome, NO_TYPE)
+    || !getVector(in, p->indices, CHUNK_AREA) || !getVector(in, p->objects, CHUNK_AREA) || !getVector(in, p->mobs, CHUNK_AREA))
+    return nullptr;
+  return p;
+}
+
+ChunkStore::~ChunkStore ()
+{
+  stopLoader();
+  delete views.load();
+  if (!evictionPath.empty())
+  {
+    std::error_code ec;
+    std::filesystem::remove_all(evictionPath, ec);
+  }
+}
+
+// Each store evicts into its own session directory under root, removed again when the store is destroyed
+void ChunkStore::configureResidency (std::size_t budget, const std::filesystem::path& root)
+{
+  memoryBudget = budget;
+  if (budget == 0)
+    return;
+  std::error_code ec;
+  evictionPath = root / ("session-" + uuid::generate_uuid_v4());
+  if (!std::filesystem::create_directories(evictionPath, ec))
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create chunk store %s; chunks will stay in memory",
+      evictionPath.c_str());
+    evictionPath.clear();
+    memoryBudget = 0;
+  }
+}
+
+Chunk* ChunkStore::unpack (std::uint64_t k)
+{
+  std::unique_lock lock(directoryMtx);
+  auto s = chunks.find(k);
+  if (s == nullptr)
+    return nullptr;
+  if (s->evicted)
+  {
+    std::error_code ec;
+    s->packed = PackedChunk::read(pathFor(k));
+    if (s->packed == nullptr)
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not read evicted chunk %d,%d on level %d", s->cx, s->cy, s->z);
+      s->chunk = std::make_unique<Chunk>(s->z, s->cx, s->cy);
+      s->chunk->journal.restart(nextJournalBase());
+    }
+    s->evicted = false;
+    s->evictedHistogram = TypeHistogram();
+    std::filesystem::remove(pathFor(k), ec);
+  }
+  if (s->chunk == nullptr)
+  {
+    s->chunk = s->packed->unpack();
+    s->packed.reset();
+    // Nothing else can reach the chunk until directoryMtx is released, so it needs no cell lock
+    handOff(s->chunk.get());
+  }
+  lastHit() = { epoch, k, s->chunk.get() };
+  touch(s->chunk.get());
+  return s->chunk.get();
+}
+
+void ChunkStore::requestFaultIn (std::uint64_t k)
+{
+  std::unique_lock lock(loaderMtx);
+  if (stopping || !faultsPending.insert(k).second)
+    return;
+  faultQueue.push_back(k);
+  if (!loader.joinable())
+    loader = std::thread(&ChunkStore::runLoader, this);
+  loaderCv.notify_one();
+}
+
+// Reads happen outside the directory lock; a loaded chunk is installed packed, and unpacked by its next lookup
+void ChunkStore::runLoader ()
+{
+  std::unique_lock lock(loaderMtx);
+  while (true)
+  {
+    loaderCv.wait(lock, [this]() { return stopping || faultQueue.size(); });
+    if (stopping)
+      return;
+    auto k = faultQueue.front();
+    faultQueue.pop_front();
+    lock.unlock();
+    auto p = PackedChunk::read(pathFor(k));
+    {
+      std::unique_lock directoryLock(directoryMtx);
+      auto s = chunks.find(k);
+      if (p != nullptr && s != nullptr && s->evicted)
+      {
+        std::error_code ec;
+        s->packed = std::move(p);
+        s->evicted = false;
+        s->evictedHistogram = TypeHistogram();
+        std::filesystem::remove(pathFor(k), ec);
+      }
+    }
+    lock.lock();
+    faultsPending.erase(k);
+  }
+}
+
+void ChunkStore::stopLoader ()
+{
+  {
+    std::unique_lock lock(loaderMtx);
+    stopping = true;
+  }
+  loaderCv.notify_all();
+  if (loader.joinable())
+    loader.join();
+  std::unique_lock lock(loaderMtx);
+  stopping = false;
+  faultQueue.clear();
+  faultsPending.clear();
+}
+
+// Frees every column of chunks (all levels at one chunk coordinate, since they are generated together) that lies
+// entirely farther than radius tiles from (x, y) and is unchanged since generation, with its objects and mobs.
+// Columns with a chunk being written to or still being generated are kept until next time.
+std::size_t ChunkStore::dropUnchanged (int x, int y, int radius)
+{
+  std::unique_lock lock(directoryMtx);
+  std::vector<std::unique_lock<std::shared_mutex>> cells;
+  std::bitset<LOCK_STRIPES> held;
+  auto claim = [this, &cells, &held](const ChunkDirectory::Slot& s) {
+    auto i = stripe(s.key);
+    if (s.chunk == nullptr || held[i])
+      return true;
+    std::unique_lock cell (cellLocks[i], std::try_to_lock);
+    if (!cell)
+      return false;
+    held[i] = true;
+    cells.push_back(std::move(cell));
+    return true;
+  };
+  std::map<std::pair<int, int>, bool> keep;
+  chunks.forEach([this, &keep, &claim, x, y, radius](ChunkDirectory::Slot& s) {
+    bool changed = s.evicted
+      || (s.chunk != nullptr && !s.chunk->delta.empty())
+      || (s.packed != nullptr && !s.packed->delta.empty());
+    auto& k = keep[{ s.cx, s.cy }];
+    k = k || changed || distance(s, x, y) <= radius || isPinned(s) || !claim(s);
+  });
+  std::vector<std::uint64_t> drop;
+  std::vector<std::uint64_t> dense;
+  chunks.forEach([&](ChunkDirectory::Slot& s) {
+    if (keep[{ s.cx, s.cy }])
+      return;
+    drop.push_back(s.key);
+    if (s.chunk != nullptr)
+    {
+      dense.push_back(s.key);
+      for (auto i = 0; i < CHUNK_AREA; i++)
+      {
+        worldObjects.clear(s.chunk->objects[i]);
+        mobObjects.clear(s.chunk->mobs[i]);
+      }
+    }
+    else
+    {
+      for (auto& [i, h] : s.packed->objects)
+        worldObjects.clear(h);
+      for (auto& [i, h] : s.packed->mobs)
+        mobObjects.clear(h);
+    }
+  });
+  for (auto k : drop)
+    chunks.erase(chunks.find(k));
+  if (dense.size())
+  {
+    epoch = nextEpoch();
+    withdraw(dense);
+  }
+  return drop.size();
+}
+
+void ChunkStore::manageResidency (int x, int y, int radius)
+{
+  clock++;
+  dropUnchanged(x, y, radius);
+  packDistant(x, y, radius);
+  std::vector<std::uint64_t> faults;
+  // Victims are copied out under the lock and written without it, so lookups on other threads don't wait on disk
+  std::vector<std::pair<const PackedChunk*, PackedChunk>> victims;
+  {
+    std::unique_lock lock(directoryMtx);
+    std::size_t resident = 0;
+    std::vector<std::pair<std::uint32_t, ChunkDirectory::Slot*>> candidates;
+    chunks.forEach([&](ChunkDirectory::Slot& s) {
+      bool near = distance(s, x, y) <= radius;
+      if (s.evicted)
+      {
+        if (near)
+          faults.push_back(s.key);
+        return;
+      }
+      // Snapshots only list dense chunks, so whatever is near enough to be drawn is unpacked ahead of the frame
+      if (near && s.packed != nullptr)
+      {
+        s.chunk = s.packed->unpack();
+        s.packed.reset();
+        handOff(s.chunk.get());
+      }
+      resident += s.chunk != nullptr ? sizeof(Chunk) : s.packed->bytes();
+      // Anything outside radius that packDistant left dense didn't pack, and stays in memory
+      if (!near && s.packed != nullptr && !isPinned(s))
+        candidates.push_back({ s.packed->lastAccess, &s });
+    });
+    if (memoryBudget > 0 && resident > memoryBudget)
+    {
+      std::sort(candidates.begin(), candidates.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+      for (auto& [t, s] : candidates)
+      {
+        if (resident <= memoryBudget)
+          break;
+        resident -= s->packed->bytes();
+        victims.push_back({ s->packed.get(), *s->packed });
+      }
+    }
+  }
+  std::vector<bool> written;
+  for (auto& [original, p] : victims)
+  {
+    written.push_back(p.write(pathFor(key(p.z, p.cx, p.cy))));
+    if (!written.back())
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not evict chunk %d,%d on level %d to %s",
+        p.cx, p.cy, p.z, evictionPath.c_str());
+      break;
+    }
+  }
+  if (written.size())
+  {
+    std::unique_lock lock(directoryMtx);
+    for (std::size_t n = 0; n < written.size() && written[n]; n++)
+    {
+      auto& [original, p] = victims[n];
+      auto k = key(p.z, p.cx, p.cy);
+      auto s = chunks.find(k);
+      // A chunk looked up since it was picked is dense again, or packed anew, and its file is already stale
+      if (s == nullptr || s->packed.get() != original || s->packed->version != p.version || s->packed->dirty != p.dirty)
+      {
+        std::error_code ec;
+        std::filesystem::remove(pathFor(k), ec);
+        continue;
+      }
+      s->evictedTiles = p.generatedCount;
+      s->evictedVersion = p.version;
+      s->evictedHistogram = p.histogram;
+      s->packed.reset();
+      s->evicted = true;
+    }
+  }
+  for (auto k : faults)
+    requestFaultIn(k);
+}
+
+std::shared_ptr<const ChunkView> ChunkStore::makeView (const Chunk& c)
+{
+  auto v = std::make_shared<ChunkView>();
+  v->generated = c.generated;
+  v->passable = c.passable;
+  v->terrain = c.terrain;
+  for (auto i = 0; i < CHUNK_AREA; i++)
+  {
+    std::uint16_t index = i;
+    worldObjects.forEach(c.objects[i], [&v, index](objects::Handle h, WorldObject* o) { v->objects.push_back({ index, h }); });
+    mobObjects.forEach(c.mobs[i], [&v, index](objects::Handle h, MobObject* m) { v->mobs.push_back({ index, h }); });
+  }
+  return v;
+}
+
+void ChunkStore::handOff (Chunk* a, Chunk* b)
+{
+  auto viewOf = [this](Chunk* c) -> std::shared_ptr<const ChunkView> {
+    return c != nullptr && c->unpublished.exchange(false) ? makeView(*c) : nullptr;
+  };
+  auto va = viewOf(a);
+  auto vb = viewOf(b);
+  if (va == nullptr && vb == nullptr)
+    return;
+  std::unique_lock lock(handOffMtx);
+  if (va != nullptr)
+    handedOff.push_back({ key(a->z, a->cx, a->cy), std::move(va) });
+  if (vb != nullptr)
+    handedOff.push_back({ key(b->z, b->cx, b->cy), std::move(vb) });
+}
+
+void ChunkStore::withdraw (const std::vector<std::uint64_t>& keys)
+{
+  std::unique_lock lock(handOffMtx);
+  for (auto k : keys)
+    handedOff.push_back({ k, nullptr });
+}
+
+// The table is only rebuilt if something was handed off. The one it replaces is retired rather than freed, since
+// readers may still be walking it.
+void ChunkStore::publish ()
+{
+  thread_local std::vector<std::pair<std::uint64_t, std::shared_ptr<const ChunkView>>> fresh;
+  {
+    std::unique_lock lock(handOffMtx);
+    fresh.swap(handedOff);
+  }
+  if (fresh.size())
+  {
+    auto old = views.load();
+    auto table = old != nullptr ? new ViewTable(*old) : new ViewTable(fresh.size());
+    for (auto& [k, v] : fresh)
+    {
+      if (v != nullptr)
+        table->insert(k, std::move(v));
+      else
+        table->erase(k);
+    }
+    fresh.clear();
+    if (auto old = views.exchange(table))
+      reclaimer.retire(old);
+  }
+  reclaimer.collect();
+}
+
+void Reclaimer::collect ()
+{
+  auto oldest = epoch.load();
+  for (auto& r : readers)
+    if (auto e = r.load(); e != 0)
+      oldest = std::min(oldest, e);
+  // A reader that entered in epoch e may still hold a table retired in e or later
+  retired.erase(std::remove_if(retired.begin(), retired.end(), [oldest](const auto& t) { return t.first < oldest; }), retired.end());
+}
@@ -1,7 +1,7 @@
 #include "uuid.h"
 
-static std::random_device rd;
-static std::mt19937 gen(rd());
+// Per thread, since mobs and their simulators are created by generation on several threads at once
+static thread_local std::mt19937 gen(std::random_device{}());
 static std::uniform_int_distribution<> dis(0, 15);
 static std::uniform_int_distribution<> dis2(8, 11);
 